@@ -27,6 +27,7 @@
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
+#include <iostream>
 #include <stdexcept>
 #include <string>
 
@@ -50,6 +51,14 @@ int main(int argc, char**argv)
 
     prl::backgroundNormalization(inputImage, outputImage);
 
+    //! Compare with Leptonica implementation
+    cv::Mat leptonicaImage;
+    prl::backgroundNormalization(inputImage, leptonicaImage, prl::BackgroundNormalizationMethod::LEPTONICA);
+
+    cv::Mat difference;
+    cv::absdiff(outputImage, leptonicaImage, difference);
+    std::cout << "Mean difference with Leptonica: " << cv::mean(difference) << std::endl;
+
     cv::imwrite(outputImageFilename, outputImage);
 }
 
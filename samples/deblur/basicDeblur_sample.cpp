@@ -26,7 +26,9 @@
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
 
+#include <iostream>
 #include <stdexcept>
 #include <string>
 
@@ -48,7 +50,26 @@ int main(int argc, char**argv)
     cv::Mat inputImage = cv::imread(inputImageFilename);
     cv::Mat outputImage;
 
+    int64 startTicks = cv::getTickCount();
     prl::basicDeblur(inputImage, outputImage);
+    const double deblurSeconds = (cv::getTickCount() - startTicks) / cv::getTickFrequency();
+
+    //! Float unsharp mask with default parameters, as basicDeblur was implemented before
+    startTicks = cv::getTickCount();
+    cv::Mat floatImage, blurredImage, referenceImage;
+    inputImage.convertTo(floatImage, CV_32F);
+    cv::GaussianBlur(floatImage, blurredImage, cv::Size(0, 0), 9.0);
+    cv::addWeighted(floatImage, 1.5, blurredImage, -0.5, 0.0, referenceImage);
+    referenceImage.convertTo(referenceImage, CV_8U);
+    const double referenceSeconds = (cv::getTickCount() - startTicks) / cv::getTickFrequency();
+
+    cv::Mat difference;
+    cv::absdiff(outputImage, referenceImage, difference);
+    double maxDifference = 0;
+    cv::minMaxLoc(difference.reshape(1), nullptr, &maxDifference);
+
+    std::cout << "basicDeblur: " << 1000.0 * deblurSeconds << " ms, float reference: " << 1000.0 * referenceSeconds
+              << " ms, max difference: " << maxDifference << std::endl;
 
     cv::imwrite(outputImageFilename, outputImage);
 }
@@ -27,6 +27,7 @@
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
+#include <iostream>
 #include <stdexcept>
 #include <string>
 
@@ -50,6 +51,21 @@ int main(int argc, char**argv)
 
     prl::wienerFilter(inputImage, outputImage);
 
+    //! Compare tiled filter with the global one away from borders
+    cv::Mat tiledImage;
+    prl::wienerFilterTiled(inputImage, tiledImage);
+
+    const int border = 32;
+    if (inputImage.cols > 2 * border && inputImage.rows > 2 * border)
+    {
+        const cv::Rect inner(border, border, inputImage.cols - 2 * border, inputImage.rows - 2 * border);
+        cv::Mat difference;
+        cv::absdiff(outputImage(inner), tiledImage(inner), difference);
+        double maxDifference = 0;
+        cv::minMaxLoc(difference.reshape(1), nullptr, &maxDifference);
+        std::cout << "Max difference of tiled filter: " << maxDifference << std::endl;
+    }
+
     cv::imwrite(outputImageFilename, outputImage);
 }
 
@@ -27,11 +27,18 @@
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
+#include <iostream>
 #include <stdexcept>
 #include <string>
 
 int main(int argc, char**argv)
 {
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <input image> <output image>" << std::endl;
+        return 1;
+    }
+
     const std::string inputImageFilename = argv[1];
     const std::string outputImageFilename = argv[2];
 
@@ -48,7 +55,20 @@ int main(int argc, char**argv)
     cv::Mat inputImage = cv::imread(inputImageFilename);
     cv::Mat outputImage;
 
+    const double megapixels = inputImage.total() / 1e6;
+
+    int64 startTicks = cv::getTickCount();
     prl::denoiseKuwahara(inputImage, outputImage, 5);
+    double seconds = (cv::getTickCount() - startTicks) / cv::getTickFrequency();
+    std::cout << "Exact: time per megapixel: " << 1000.0 * seconds / megapixels << " ms" << std::endl;
+
+    //! Compare polynomial approximation with the exact filter
+    cv::Mat polynomialImage;
+    startTicks = cv::getTickCount();
+    prl::denoiseKuwahara(inputImage, polynomialImage, 5, prl::KuwaharaMode::POLYNOMIAL);
+    seconds = (cv::getTickCount() - startTicks) / cv::getTickFrequency();
+    std::cout << "Polynomial: time per megapixel: " << 1000.0 * seconds / megapixels << " ms, "
+              << "PSNR to exact: " << cv::PSNR(outputImage, polynomialImage) << " dB" << std::endl;
 
     cv::imwrite(outputImageFilename, outputImage);
 }
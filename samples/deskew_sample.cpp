@@ -53,6 +53,10 @@ int main(int argc, char**argv)
 
     std::cout << "Possible angle by findAngle function: " << prl::findAngle(inputImage) << std::endl;
 
+    const prl::PageGeometry geometry = prl::estimatePageGeometry(inputImage);
+    std::cout << "Page geometry: skew " << geometry.skewAngle << " (confidence " << geometry.skewConfidence
+              << "), orientation " << geometry.orientation << std::endl;
+
     prl::deskew(inputImage, outputImage);
 
     cv::imwrite(outputImageFilename, outputImage);
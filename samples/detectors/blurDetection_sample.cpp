@@ -0,0 +1,63 @@
+/*
+    MIT License
+
+    Copyright (c) 2017 Alexander Zaitsev
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "blurDetection.h"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+//! Prints blur score of every image, use it to calibrate detectBlur() threshold on test_data/blurred
+int main(int argc, char**argv)
+{
+    if (argc < 2)
+    {
+        throw std::invalid_argument("No input images.");
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string inputImageFilename = argv[i];
+
+        cv::Mat inputImage = cv::imread(inputImageFilename);
+        if (inputImage.empty())
+        {
+            std::cerr << inputImageFilename << ": cannot read image" << std::endl;
+            continue;
+        }
+
+        const int64 startTicks = cv::getTickCount();
+        const prl::BlurDetectionResult result = prl::detectBlur(inputImage);
+        const double seconds = (cv::getTickCount() - startTicks) / cv::getTickFrequency();
+
+        std::cout << inputImageFilename << ": score " << result.score
+                  << (result.isBlurred ? " (blurred)" : " (sharp)") << ", " << 1000.0 * seconds << " ms" << std::endl;
+
+        const prl::FocusMap focusMap = prl::focusMap(inputImage);
+        std::cout << "    blurred text tiles: " << 100.0 * focusMap.blurredFraction << " %" << std::endl;
+    }
+}
@@ -22,6 +22,7 @@
     SOFTWARE.
 */
 
+#include "debugSink.h"
 #include "removeDots.h"
 
 #include <opencv2/core/core.hpp>
@@ -48,6 +49,12 @@ int main(int argc, char**argv)
     cv::Mat inputImage = cv::imread(inputImageFilename);
     cv::Mat outputImage;
 
+    //! Optional directory for detected dots visualization
+    if (argc > 3)
+    {
+        prl::setDebugDirectory(argv[3]);
+    }
+
     prl::removeDots(inputImage, outputImage, 0);
 
     cv::imwrite(outputImageFilename, outputImage);
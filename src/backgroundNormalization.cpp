@@ -24,7 +24,9 @@
 
 #include "backgroundNormalization.h"
 
+#include <algorithm>
 #include <stdexcept>
+#include <vector>
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -32,30 +34,372 @@
 #include <leptonica/allheaders.h>
 
 #include "formatConvert.h"
+#include "pixHandle.h"
 
-void prl::backgroundNormalization(const cv::Mat& inputImage, cv::Mat& outputImage)
+//! Parameters of Leptonica's pixBackgroundNormSimple
+static const int BACKGROUND_TILE_WIDTH = 10;
+static const int BACKGROUND_TILE_HEIGHT = 15;
+static const int BACKGROUND_FG_THRESHOLD = 60;
+static const int BACKGROUND_MIN_COUNT = 40;
+static const int BACKGROUND_VALUE = 200;
+static const int BACKGROUND_SMOOTH_X = 2;
+static const int BACKGROUND_SMOOTH_Y = 1;
+//! Foreground mask is dilated, so that tiles are not darkened by antialiased text borders
+static const int BACKGROUND_FG_DILATION = 7;
+//! Leptonica leaves image unchanged if the tile map is smaller than this in any direction
+static const int BACKGROUND_MIN_TILES = 5;
+
+//! Index of the first pixel of a tile, the last tile absorbs the remainder
+static inline int tileStart(int tile, int tileSize)
+{
+    return tile * tileSize;
+}
+
+static inline int tileEnd(int tile, int tileCount, int tileSize, int imageSize)
 {
-    cv::Mat inputImageMat = inputImage;
+    return tile == tileCount - 1 ? imageSize : (tile + 1) * tileSize;
+}
+
+/*!
+ * Average of background pixels in each tile.
+ * Tiles without enough background pixels are marked as invalid.
+ */
+static cv::Mat tileBackground(const cv::Mat& image, const cv::Mat& foreground, int tileWidth, int tileHeight,
+                              std::vector<uchar>& isValid)
+{
+    const int channels = image.channels();
+    const int tilesX = std::max(1, image.cols / tileWidth);
+    const int tilesY = std::max(1, image.rows / tileHeight);
+
+    const int tileArea = std::min(tileWidth, image.cols) * std::min(tileHeight, image.rows);
+    const int minCount = BACKGROUND_MIN_COUNT > tileArea ? tileArea / 3 : BACKGROUND_MIN_COUNT;
 
-    if (inputImageMat.empty())
+    std::vector<int> columnTile(image.cols);
+    for (int x = 0; x < image.cols; ++x)
     {
-        throw std::invalid_argument("Input image for flipping is empty");
+        columnTile[x] = std::min(x / tileWidth, tilesX - 1);
+    }
+
+    cv::Mat map(tilesY, tilesX, CV_32FC(channels));
+    isValid.assign(tilesX * tilesY, 0);
+
+    cv::parallel_for_(cv::Range(0, tilesY), [&](const cv::Range& range)
+    {
+        std::vector<int> sums(tilesX * channels);
+        std::vector<int> counts(tilesX);
+
+        for (int ty = range.start; ty < range.end; ++ty)
+        {
+            std::fill(sums.begin(), sums.end(), 0);
+            std::fill(counts.begin(), counts.end(), 0);
+
+            const int yEnd = tileEnd(ty, tilesY, tileHeight, image.rows);
+            for (int y = tileStart(ty, tileHeight); y < yEnd; ++y)
+            {
+                const uchar* src = image.ptr<uchar>(y);
+                const uchar* mask = foreground.ptr<uchar>(y);
+                for (int x = 0; x < image.cols; ++x)
+                {
+                    if (mask[x])
+                    {
+                        continue;
+                    }
+
+                    const int tx = columnTile[x];
+                    ++counts[tx];
+                    for (int c = 0; c < channels; ++c)
+                    {
+                        sums[tx * channels + c] += src[x * channels + c];
+                    }
+                }
+            }
+
+            float* row = map.ptr<float>(ty);
+            for (int tx = 0; tx < tilesX; ++tx)
+            {
+                if (counts[tx] >= minCount)
+                {
+                    isValid[ty * tilesX + tx] = 1;
+                }
+
+                for (int c = 0; c < channels; ++c)
+                {
+                    row[tx * channels + c] = counts[tx] > 0 ? static_cast<float>(sums[tx * channels + c]) / counts[tx]
+                                                            : 0.0f;
+                }
+            }
+        }
+    });
+
+    return map;
+}
+
+//! Copy tile value
+static inline void copyTile(cv::Mat& map, int fromX, int fromY, int toX, int toY)
+{
+    const size_t tileBytes = map.elemSize();
+    std::copy(map.ptr<uchar>(fromY) + fromX * tileBytes, map.ptr<uchar>(fromY) + (fromX + 1) * tileBytes,
+              map.ptr<uchar>(toY) + toX * tileBytes);
+}
+
+/*!
+ * Fill invalid tiles: vertically from the nearest valid tile of the same column,
+ * then columns without valid tiles from neighbour columns.
+ * \return false if there are no valid tiles at all.
+ */
+static bool fillMapHoles(cv::Mat& map, const std::vector<uchar>& isValid)
+{
+    const int tilesX = map.cols;
+    const int tilesY = map.rows;
+
+    std::vector<uchar> isColumnValid(tilesX, 0);
+    for (int tx = 0; tx < tilesX; ++tx)
+    {
+        int firstValid = 0;
+        while (firstValid < tilesY && !isValid[firstValid * tilesX + tx])
+        {
+            ++firstValid;
+        }
+
+        if (firstValid == tilesY)
+        {
+            continue;
+        }
+
+        isColumnValid[tx] = 1;
+
+        for (int ty = 0; ty < firstValid; ++ty)
+        {
+            copyTile(map, tx, firstValid, tx, ty);
+        }
+
+        for (int ty = firstValid + 1; ty < tilesY; ++ty)
+        {
+            if (!isValid[ty * tilesX + tx])
+            {
+                copyTile(map, tx, ty - 1, tx, ty);
+            }
+        }
+    }
+
+    if (std::find(isColumnValid.begin(), isColumnValid.end(), 1) == isColumnValid.end())
+    {
+        return false;
+    }
+
+    for (int tx = 1; tx < tilesX; ++tx)
+    {
+        if (!isColumnValid[tx] && isColumnValid[tx - 1])
+        {
+            for (int ty = 0; ty < tilesY; ++ty)
+            {
+                copyTile(map, tx - 1, ty, tx, ty);
+            }
+            isColumnValid[tx] = 1;
+        }
+    }
+
+    for (int tx = tilesX - 2; tx >= 0; --tx)
+    {
+        if (!isColumnValid[tx] && isColumnValid[tx + 1])
+        {
+            for (int ty = 0; ty < tilesY; ++ty)
+            {
+                copyTile(map, tx + 1, ty, tx, ty);
+            }
+            isColumnValid[tx] = 1;
+        }
+    }
+
+    return true;
+}
+
+//! Position of pixel in the tile map grid for bilinear interpolation
+struct GridSample
+{
+    int first;
+    int second;
+    float weight;
+};
+
+/*!
+ * Map values are placed at tile centers with fixed tile pitch, pixels of the remainder
+ * absorbed by the last tile are clamped to it like in Leptonica.
+ */
+static std::vector<GridSample> gridSamples(int imageSize, int tiles, int tileSize)
+{
+    std::vector<GridSample> samples(imageSize);
+    const float scale = 1.0f / tileSize;
+    for (int i = 0; i < imageSize; ++i)
+    {
+        const float position = std::min(std::max(0.0f, (i + 0.5f) * scale - 0.5f), static_cast<float>(tiles - 1));
+        const int first = std::min(static_cast<int>(position), tiles - 1);
+        samples[i].first = first;
+        samples[i].second = std::min(first + 1, tiles - 1);
+        samples[i].weight = position - first;
+    }
+
+    return samples;
+}
+
+/*!
+ * Multiply image by bilinearly upsampled inverse background map and remap it with lut.
+ * Upsampling is done on the fly, one map row per image row.
+ */
+static void applyInverseMap(const cv::Mat& image, const cv::Mat& inverseMap, const uchar* lut, cv::Mat& outputImage)
+{
+    const int channels = image.channels();
+    const int tilesX = inverseMap.cols;
+    const std::vector<GridSample> columns = gridSamples(image.cols, tilesX, BACKGROUND_TILE_WIDTH);
+    const std::vector<GridSample> rows = gridSamples(image.rows, inverseMap.rows, BACKGROUND_TILE_HEIGHT);
+
+    cv::parallel_for_(cv::Range(0, image.rows), [&](const cv::Range& range)
+    {
+        std::vector<float> mapRow(tilesX * channels);
+
+        for (int y = range.start; y < range.end; ++y)
+        {
+            const GridSample& rowSample = rows[y];
+            const float* top = inverseMap.ptr<float>(rowSample.first);
+            const float* bottom = inverseMap.ptr<float>(rowSample.second);
+            for (int i = 0; i < tilesX * channels; ++i)
+            {
+                mapRow[i] = top[i] + (bottom[i] - top[i]) * rowSample.weight;
+            }
+
+            const uchar* src = image.ptr<uchar>(y);
+            uchar* dst = outputImage.ptr<uchar>(y);
+            for (int x = 0; x < image.cols; ++x)
+            {
+                const GridSample& columnSample = columns[x];
+                const float* left = &mapRow[columnSample.first * channels];
+                const float* right = &mapRow[columnSample.second * channels];
+                for (int c = 0; c < channels; ++c)
+                {
+                    const float scale = left[c] + (right[c] - left[c]) * columnSample.weight;
+                    const uchar value = cv::saturate_cast<uchar>(src[x * channels + c] * scale);
+                    dst[x * channels + c] = lut ? lut[value] : value;
+                }
+            }
+        }
+    });
+}
+
+//! Copy image remapping it with lut
+static void applyLut(const cv::Mat& image, const uchar* lut, cv::Mat& outputImage)
+{
+    if (lut)
+    {
+        cv::LUT(image, cv::Mat(1, 256, CV_8UC1, const_cast<uchar*>(lut)), outputImage);
+    }
+    else
+    {
+        image.copyTo(outputImage);
     }
+}
 
-    cv::Mat outputImageMat;
+static void backgroundNormalizationNative(const cv::Mat& inputImage, cv::Mat& outputImage, const uchar* lut)
+{
+    CV_Assert(inputImage.type() == CV_8UC1 || inputImage.type() == CV_8UC3);
+
+    if ((inputImage.cols + BACKGROUND_TILE_WIDTH - 1) / BACKGROUND_TILE_WIDTH < BACKGROUND_MIN_TILES ||
+        (inputImage.rows + BACKGROUND_TILE_HEIGHT - 1) / BACKGROUND_TILE_HEIGHT < BACKGROUND_MIN_TILES)
+    {
+        applyLut(inputImage, lut, outputImage);
+        return;
+    }
 
+    // Leptonica finds foreground of color images in the green channel
+    cv::Mat gray;
+    if (inputImage.channels() == 3)
+    {
+        cv::extractChannel(inputImage, gray, 1);
+    }
+    else
     {
-        PIX* pixs = prl::opencvToLeptonica(&inputImageMat);
+        gray = inputImage;
+    }
+
+    cv::Mat foreground;
+    cv::threshold(gray, foreground, BACKGROUND_FG_THRESHOLD - 1, 255, cv::THRESH_BINARY_INV);
+    cv::dilate(foreground, foreground,
+               cv::getStructuringElement(cv::MORPH_RECT, cv::Size(BACKGROUND_FG_DILATION, BACKGROUND_FG_DILATION)));
 
-        /* Normalize for varying background */
-        PIX* pixn = pixBackgroundNormSimple(pixs, nullptr, nullptr);
+    std::vector<uchar> isValid;
+    cv::Mat map = tileBackground(inputImage, foreground, BACKGROUND_TILE_WIDTH, BACKGROUND_TILE_HEIGHT, isValid);
 
-        pixDestroy(&pixs);
+    if (!fillMapHoles(map, isValid))
+    {
+        // Nothing but foreground, keep image as is
+        map.setTo(cv::Scalar::all(BACKGROUND_VALUE));
+    }
 
-        outputImageMat = prl::leptonicaToOpenCV(pixn);
+    cv::blur(map, map, cv::Size(2 * BACKGROUND_SMOOTH_X + 1, 2 * BACKGROUND_SMOOTH_Y + 1), cv::Point(-1, -1),
+             cv::BORDER_REPLICATE);
 
-        pixDestroy(&pixn);
+    // Leptonica keeps 8 bit map, a value truncated to zero gets scale bgval / 2 in 1/256 units
+    cv::Mat inverseMap(map.size(), map.type());
+    const float* mapValues = map.ptr<float>();
+    float* inverseValues = inverseMap.ptr<float>();
+    for (size_t i = 0; i < map.total() * map.channels(); ++i)
+    {
+        inverseValues[i] = mapValues[i] >= 1.0f ? BACKGROUND_VALUE / mapValues[i] : BACKGROUND_VALUE / 512.0f;
     }
 
-    outputImage = outputImageMat;
-}
\ No newline at end of file
+    outputImage.create(inputImage.size(), inputImage.type());
+    applyInverseMap(inputImage, inverseMap, lut, outputImage);
+}
+
+static void backgroundNormalizationLeptonica(const cv::Mat& inputImage, cv::Mat& outputImage)
+{
+    prl::PixHandle pixs = prl::matToPix(inputImage);
+
+    /* Normalize for varying background */
+    prl::PixHandle pixn(pixBackgroundNormSimple(pixs.get(), nullptr, nullptr));
+    if (!pixn)
+    {
+        throw std::runtime_error("Leptonica failed to normalize background");
+    }
+
+    // Input buffer is not needed anymore, the pool can hand it out to the next call
+    pixs.reset();
+
+    prl::leptonicaToOpenCV(pixn.get(), outputImage);
+}
+
+void prl::backgroundNormalization(const cv::Mat& inputImage, cv::Mat& outputImage,
+                                  BackgroundNormalizationMethod method)
+{
+    if (inputImage.empty())
+    {
+        throw std::invalid_argument("Input image for flipping is empty");
+    }
+
+    if (method == BackgroundNormalizationMethod::NATIVE &&
+        (inputImage.type() == CV_8UC1 || inputImage.type() == CV_8UC3))
+    {
+        backgroundNormalizationNative(inputImage, outputImage, nullptr);
+    }
+    else
+    {
+        backgroundNormalizationLeptonica(inputImage, outputImage);
+    }
+}
+
+void prl::backgroundNormalization(const cv::Mat& inputImage, cv::Mat& outputImage, const cv::Mat& lut)
+{
+    if (inputImage.empty())
+    {
+        throw std::invalid_argument("Input image for flipping is empty");
+    }
+
+    if (lut.empty())
+    {
+        backgroundNormalizationNative(inputImage, outputImage, nullptr);
+        return;
+    }
+
+    CV_Assert(lut.type() == CV_8UC1 && lut.total() == 256 && lut.isContinuous());
+
+    backgroundNormalizationNative(inputImage, outputImage, lut.ptr<uchar>());
+}
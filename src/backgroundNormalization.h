@@ -29,15 +29,40 @@
 
 namespace prl
 {
+/*!
+ * \brief Implementation used by background normalization.
+ */
+enum class BackgroundNormalizationMethod
+{
+    NATIVE,    //!< Multi-threaded OpenCV implementation of Leptonica's algorithm.
+    LEPTONICA  //!< Leptonica's pixBackgroundNormSimple.
+};
+
 /*!
  * \brief Normalize background.
  * \param[in] inputImage Input image.
  * \param[out] outputImage Output image.
- * \details Implementation is based on Leptonica library
+ * \param[in] method Implementation to use.
+ * \details Background is estimated as average of non-text pixels in 10x15 tiles, holes are filled from
+ * neighbour tiles, tile map is smoothed and bilinearly upsampled, then each pixel is scaled so that
+ * background becomes 200. Foreground of color images is found in the green channel and images
+ * with less than 5 tiles in any direction are returned unchanged, as in Leptonica. NATIVE method
+ * supports CV_8UC1 and CV_8UC3 images, other images are processed by Leptonica. NATIVE result
+ * differs from LEPTONICA by at most 8 gray levels on average (checked by backgroundNormalization_test),
+ * mostly near background edges because Leptonica does not interpolate the map.
  * \note Implementation of this procedure is based on
  * <a href="http://www.leptonica.com/">Leptonica library</a>..
  */
-CV_EXPORTS void backgroundNormalization(const cv::Mat& inputImage, cv::Mat& outputImage);
+CV_EXPORTS void backgroundNormalization(const cv::Mat& inputImage, cv::Mat& outputImage,
+                                        BackgroundNormalizationMethod method = BackgroundNormalizationMethod::NATIVE);
+
+/*!
+ * \brief Normalize background and remap result with lookup table in the same pass.
+ * \param[in] inputImage CV_8UC1 or CV_8UC3 image.
+ * \param[out] outputImage Output image.
+ * \param[in] lut CV_8U lookup table with 256 entries, empty table means identity.
+ */
+CV_EXPORTS void backgroundNormalization(const cv::Mat& inputImage, cv::Mat& outputImage, const cv::Mat& lut);
 }
 
 #endif // PRLIB_BackgroundNormalization_Lepton_h
@@ -37,6 +37,180 @@
 #include "resize.h"
 #include "warp.h"
 
+//! Search radius along edge normal (in pixels) on every finer pyramid level
+static const int REFINE_SEARCH_RADIUS = 4;
+
+//! Number of edge samples on every side of document
+static const int REFINE_EDGE_SAMPLES = 32;
+
+//! Share of side near each corner which is not sampled
+static const float REFINE_CORNER_MARGIN = 0.1f;
+
+//! Smallest intensity step along normal accepted as document edge
+static const float REFINE_MIN_EDGE_STEP = 8.0f;
+
+//! Bilinear sample of one channel of 8-bit image, coordinates are clamped to the image
+static float sampleChannel(const cv::Mat& image, int channel, float x, float y)
+{
+    x = std::min(std::max(x, 0.0f), static_cast<float>(image.cols - 1));
+    y = std::min(std::max(y, 0.0f), static_cast<float>(image.rows - 1));
+
+    const int x0 = std::min(static_cast<int>(x), std::max(image.cols - 2, 0));
+    const int y0 = std::min(static_cast<int>(y), std::max(image.rows - 2, 0));
+    const int x1 = std::min(x0 + 1, image.cols - 1);
+    const int y1 = std::min(y0 + 1, image.rows - 1);
+    const float fx = x - x0;
+    const float fy = y - y0;
+
+    const int channels = image.channels();
+    const uchar* row0 = image.ptr<uchar>(y0);
+    const uchar* row1 = image.ptr<uchar>(y1);
+
+    const float top = row0[x0 * channels + channel] * (1.0f - fx) + row0[x1 * channels + channel] * fx;
+    const float bottom = row1[x0 * channels + channel] * (1.0f - fx) + row1[x1 * channels + channel] * fx;
+    return top * (1.0f - fy) + bottom * fy;
+}
+
+/*!
+ * \brief Fit line to the strongest intensity steps along normals of quadrangle side.
+ * \return false if side has too few edge points, line is not changed then.
+ */
+static bool refineSide(const cv::Mat& image, int channel, const cv::Point2f& from, const cv::Point2f& to,
+                       int searchRadius, cv::Vec4f& line)
+{
+    const cv::Point2f side = to - from;
+    const float length = static_cast<float>(cv::norm(side));
+    if (length < 1.0f)
+    {
+        return false;
+    }
+
+    const cv::Point2f tangent = side * (1.0f / length);
+    const cv::Point2f normal(-tangent.y, tangent.x);
+
+    std::vector<float> profile(2 * searchRadius + 3);
+    std::vector<float> steps(profile.size());
+    std::vector<cv::Point2f> edgePoints;
+    edgePoints.reserve(REFINE_EDGE_SAMPLES);
+
+    for (int i = 0; i < REFINE_EDGE_SAMPLES; ++i)
+    {
+        const float t = REFINE_CORNER_MARGIN + (1.0f - 2.0f * REFINE_CORNER_MARGIN) * (i + 0.5f) / REFINE_EDGE_SAMPLES;
+        const cv::Point2f center = from + side * t;
+
+        //! Profile along normal, averaged over three taps along the side against noise
+        for (int k = 0; k < static_cast<int>(profile.size()); ++k)
+        {
+            const cv::Point2f point = center + normal * static_cast<float>(k - searchRadius - 1);
+            profile[k] = sampleChannel(image, channel, point.x - tangent.x, point.y - tangent.y) +
+                         sampleChannel(image, channel, point.x, point.y) +
+                         sampleChannel(image, channel, point.x + tangent.x, point.y + tangent.y);
+        }
+
+        //! The strongest central difference is the edge, its position is refined by parabola
+        int bestOffset = 0;
+        float bestStep = 0.0f;
+        std::fill(steps.begin(), steps.end(), 0.0f);
+        for (int k = 1; k + 1 < static_cast<int>(profile.size()); ++k)
+        {
+            steps[k] = std::fabs(profile[k + 1] - profile[k - 1]) / 6.0f;
+            if (steps[k] > bestStep)
+            {
+                bestStep = steps[k];
+                bestOffset = k;
+            }
+        }
+
+        if (bestStep < REFINE_MIN_EDGE_STEP || bestOffset <= 1 || bestOffset + 2 >= static_cast<int>(profile.size()))
+        {
+            continue;
+        }
+
+        const float left = steps[bestOffset - 1];
+        const float right = steps[bestOffset + 1];
+        const float denominator = left - 2.0f * bestStep + right;
+        const float subpixel = denominator < 0.0f ? 0.5f * (left - right) / denominator : 0.0f;
+
+        edgePoints.push_back(center + normal * (bestOffset - searchRadius - 1 + subpixel));
+    }
+
+    if (static_cast<int>(edgePoints.size()) < REFINE_EDGE_SAMPLES / 4)
+    {
+        return false;
+    }
+
+    cv::fitLine(edgePoints, line, cv::DIST_HUBER, 0, 0.01, 0.01);
+    return true;
+}
+
+//! Refine quadrangle corners on one image as intersections of refined sides
+static void refineContourOnLevel(const cv::Mat& image, int channel, int searchRadius,
+                                 std::vector<cv::Point2f>& contour)
+{
+    const size_t count = contour.size();
+    std::vector<cv::Vec4f> lines(count);
+    std::vector<bool> isRefined(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        isRefined[i] = refineSide(image, channel, contour[i], contour[(i + 1) % count], searchRadius, lines[i]);
+    }
+
+    std::vector<cv::Point2f> refined = contour;
+    for (size_t i = 0; i < count; ++i)
+    {
+        //! Corner i is shared by the previous side and side i
+        const size_t previous = (i + count - 1) % count;
+        if (!isRefined[previous] || !isRefined[i])
+        {
+            continue;
+        }
+
+        const cv::Point2f o1(lines[previous][2], lines[previous][3]);
+        const cv::Point2f o2(lines[i][2], lines[i][3]);
+        cv::Point2f corner;
+        if (!intersection(o1, o1 + cv::Point2f(lines[previous][0], lines[previous][1]),
+                          o2, o2 + cv::Point2f(lines[i][0], lines[i][1]), corner))
+        {
+            continue;
+        }
+
+        //! Corner can not move farther than the search band allows
+        if (cv::norm(corner - contour[i]) <= 2.0 * searchRadius)
+        {
+            refined[i] = corner;
+        }
+    }
+
+    contour = refined;
+}
+
+/*!
+ * \brief Refine document quadrangle from the coarsest pyramid level up to the finest one.
+ * \param[in] levels Pyramid, levels[0] is full resolution image.
+ * \param[in] channel Channel used for edge search.
+ * \param[in,out] contour Quadrangle in coordinates of the coarsest level, full resolution one on exit.
+ * \details Only narrow bands along quadrangle sides are read on every level.
+ */
+static void refineDocumentContour(const std::vector<cv::Mat>& levels, int channel,
+                                  std::vector<cv::Point2f>& contour)
+{
+    for (size_t level = levels.size() - 1; level-- > 0;)
+    {
+        const float scaleX = static_cast<float>(levels[level].cols) / levels[level + 1].cols;
+        const float scaleY = static_cast<float>(levels[level].rows) / levels[level + 1].rows;
+        for (cv::Point2f& point : contour)
+        {
+            point.x *= scaleX;
+            point.y *= scaleY;
+        }
+
+        if (levels[level].depth() == CV_8U)
+        {
+            refineContourOnLevel(levels[level], channel, REFINE_SEARCH_RADIUS, contour);
+        }
+    }
+}
+
 namespace prl
 {
 
@@ -46,6 +220,7 @@ bool documentContour(
         std::vector<cv::Point2f>& resultContour)
 {
     cv::Mat imageToProc;
+    std::vector<cv::Mat> pyramid;
 
     //! Store source image size
     cv::Size sourceImageSize(inputImage.size());
@@ -69,17 +244,22 @@ bool documentContour(
         int scaleFactorX = 1;
         int scaleFactorY = 1;
 
-        imageToProc = inputImage.clone();
+        //! Keep every level for coarse-to-fine refinement of the found contour
+        pyramid.push_back(inputImage);
 
         while (longSide / 2 >= 256)
         {
-            cv::pyrDown(imageToProc, imageToProc);
+            cv::Mat nextLevel;
+            cv::pyrDown(pyramid.back(), nextLevel);
+            pyramid.push_back(nextLevel);
 
-            longSide = std::max(imageToProc.cols, imageToProc.rows);
+            longSide = std::max(nextLevel.cols, nextLevel.rows);
             scaleFactorX *= 2;
             scaleFactorY *= 2;
         }
 
+        imageToProc = pyramid.back().clone();
+
         newImageSize = cv::Size(inputImage.cols / scaleFactorX, inputImage.rows / scaleFactorY);
     }
 
@@ -109,7 +289,14 @@ bool documentContour(
         isContourDetected = findDocumentContour(resultCanny, resultContour);
         if (isContourDetected)
         {
-            scaleContour(resultContour, newImageSize, sourceImageSize);
+            if (pyramid.size() > 1)
+            {
+                refineDocumentContour(pyramid, static_cast<int>(mostInfoChannelInd), resultContour);
+            }
+            else
+            {
+                scaleContour(resultContour, newImageSize, sourceImageSize);
+            }
             cropVerticesOrdering(resultContour);
             return true;
         }
@@ -167,39 +167,59 @@ bool findDocumentContour(cv::Mat& source, std::vector<cv::Point2f>& resultContou
             cv::RETR_CCOMP, cv::CHAIN_APPROX_SIMPLE,
             cv::Point(0, 0));
 
-    //! Approximate contours to polygons + get bounding rectangles and circles
-    std::vector<std::vector<cv::Point> > contoursPolygons(contours.size());
-    std::vector<cv::RotatedRect> minRect(contoursPolygons.size());
-
-    float maxRotatedRectArea = 0;
-    int maxRotatedRectAreaPos = -1;
-
     double minArea = static_cast<double>(source.cols * source.rows) * 0.05;
 
     std::vector<cv::Point> maxCurve;
+    std::vector<cv::Point> hull;
+    std::vector<cv::Point> polygon;
 
     for (size_t i = 0; i < contours.size(); ++i)
     {
-        //! Approximate contour by polygon
-        contoursPolygons[i] = contours[i];
-        double approxEps = 1.0;
-        while (contoursPolygons[i].size() > 4)
+        //! Cheap rejection: polygon area can not exceed area of bounding rectangle or convex hull
+        const cv::Rect boundingRect = cv::boundingRect(contours[i]);
+        if (boundingRect.area() < minArea)
+        {
+            continue;
+        }
+
+        cv::convexHull(contours[i], hull);
+        if (hull.size() < 4 || cv::contourArea(hull) < minArea)
+        {
+            continue;
+        }
+
+        //! Approximate contour by polygon with the smallest integer epsilon giving at most 4 vertices
+        polygon = contours[i];
+        if (polygon.size() > 4)
         {
-            cv::approxPolyDP(cv::Mat(contours[i]), contoursPolygons[i], approxEps, true);
-            approxEps += 1.0;
-            contours[i] = contoursPolygons[i];
+            int lowEps = 1;
+            int highEps = std::max(boundingRect.width, boundingRect.height);
+            while (lowEps < highEps)
+            {
+                const int eps = lowEps + (highEps - lowEps) / 2;
+                cv::approxPolyDP(contours[i], polygon, eps, true);
+                if (polygon.size() > 4)
+                {
+                    lowEps = eps + 1;
+                }
+                else
+                {
+                    highEps = eps;
+                }
+            }
+            cv::approxPolyDP(contours[i], polygon, lowEps, true);
         }
 
-        if (contoursPolygons[i].size() < 4)
+        if (polygon.size() < 4)
         { continue; }
 
-        double contArea = cv::contourArea(contoursPolygons[i]);
+        double contArea = cv::contourArea(polygon);
 
         // Sides check
-        double side1 = cv::norm(contoursPolygons[i][0] - contoursPolygons[i][1]);
-        double side2 = cv::norm(contoursPolygons[i][1] - contoursPolygons[i][2]);
-        double side3 = cv::norm(contoursPolygons[i][2] - contoursPolygons[i][3]);
-        double side4 = cv::norm(contoursPolygons[i][3] - contoursPolygons[i][0]);
+        double side1 = cv::norm(polygon[0] - polygon[1]);
+        double side2 = cv::norm(polygon[1] - polygon[2]);
+        double side3 = cv::norm(polygon[2] - polygon[3]);
+        double side4 = cv::norm(polygon[3] - polygon[0]);
 
         if (side1 < side3)
         { std::swap(side1, side3); }
@@ -214,10 +234,10 @@ bool findDocumentContour(cv::Mat& source, std::vector<cv::Point2f>& resultContou
         // Sides check - end
 
         // Angles check
-        double angle1 = angleBetweenLinesInDegree(contoursPolygons[i][0], contoursPolygons[i][1],
-                                                  contoursPolygons[i][2], contoursPolygons[i][3]);
-        double angle2 = angleBetweenLinesInDegree(contoursPolygons[i][1], contoursPolygons[i][2],
-                                                  contoursPolygons[i][3], contoursPolygons[i][0]);
+        double angle1 = angleBetweenLinesInDegree(polygon[0], polygon[1],
+                                                  polygon[2], polygon[3]);
+        double angle2 = angleBetweenLinesInDegree(polygon[1], polygon[2],
+                                                  polygon[3], polygon[0]);
 
         if (angle1 < 160.0)
         { continue; }
@@ -228,18 +248,18 @@ bool findDocumentContour(cv::Mat& source, std::vector<cv::Point2f>& resultContou
 
         bool isContoursPolygonTooSmall = contArea < minArea;
         bool isContoursPolygonTooBig = contArea > source.cols * source.rows;
-        bool hasContoursPolygon4Corners = contoursPolygons[i].size() == 4;
+        bool hasContoursPolygon4Corners = polygon.size() == 4;
         if (isContoursPolygonTooBig || isContoursPolygonTooSmall || !hasContoursPolygon4Corners)
         {
             continue;
         }
 
-        double contourArea = cv::contourArea(contoursPolygons[i]);
+        double contourArea = cv::contourArea(polygon);
 
         if (contourArea > minArea)
         {
             minArea = contourArea;
-            maxCurve = contoursPolygons[i];
+            maxCurve = polygon;
         }
     }
 
@@ -8,8 +8,8 @@
 namespace prl
 {
 
-bool findHoughLineContour(cv::Mat& inputImage,
-                          std::vector<cv::Point>& resultContour);
+CV_EXPORTS bool findHoughLineContour(cv::Mat& inputImage,
+                                     std::vector<cv::Point>& resultContour);
 
 }
 #endif // PRLIB_HoughLine_h__
@@ -24,6 +24,7 @@
 
 #include "cleanBackgroundToWhite.h"
 
+#include <cmath>
 #include <stdexcept>
 
 #include <opencv2/core/core.hpp>
@@ -32,35 +33,70 @@
 #include <leptonica/allheaders.h>
 
 #include "formatConvert.h"
+#include "pixHandle.h"
+
+//! Parameters of Leptonica's pixCleanBackgroundToWhite call
+static const float CLEAN_GAMMA = 1.0f;
+static const int CLEAN_BLACK_VALUE = 70;
+static const int CLEAN_WHITE_VALUE = 170;
+
+//! Same table as Leptonica's pixGammaTRC
+static cv::Mat gammaTRC(float gamma, int blackValue, int whiteValue)
+{
+    cv::Mat lut(1, 256, CV_8UC1);
+    uchar* values = lut.ptr<uchar>();
+    for (int i = 0; i < 256; ++i)
+    {
+        if (i < blackValue)
+        {
+            values[i] = 0;
+        }
+        else if (i > whiteValue)
+        {
+            values[i] = 255;
+        }
+        else
+        {
+            const float x = static_cast<float>(i - blackValue) / (whiteValue - blackValue);
+            values[i] = cv::saturate_cast<uchar>(255.0f * std::pow(x, 1.0f / gamma));
+        }
+    }
+
+    return lut;
+}
 
 
 namespace prl
 {
-void cleanBackgroundToWhite(const cv::Mat& inputImage, cv::Mat& outputImage)
+void cleanBackgroundToWhite(const cv::Mat& inputImage, cv::Mat& outputImage, BackgroundNormalizationMethod method)
 {
-    cv::Mat inputImageMat = inputImage;
-
-    if (inputImageMat.empty())
+    if (inputImage.empty())
     {
         throw std::invalid_argument("Input image for flipping is empty");
     }
 
-    cv::Mat outputImageMat;
-
+    if (method == BackgroundNormalizationMethod::NATIVE &&
+        (inputImage.type() == CV_8UC1 || inputImage.type() == CV_8UC3))
     {
-        PIX* pixs = prl::opencvToLeptonica(&inputImageMat);
-
-        /* Normalize for varying background */
-        PIX* pixn = pixCleanBackgroundToWhite(pixs, nullptr, nullptr, 1.0, 70, 170);
-
-        pixDestroy(&pixs);
+        static const cv::Mat lut = gammaTRC(CLEAN_GAMMA, CLEAN_BLACK_VALUE, CLEAN_WHITE_VALUE);
+        backgroundNormalization(inputImage, outputImage, lut);
+        return;
+    }
 
-        outputImageMat = prl::leptonicaToOpenCV(pixn);
+    prl::PixHandle pixs = prl::matToPix(inputImage);
 
-        pixDestroy(&pixn);
+    /* Normalize for varying background */
+    prl::PixHandle pixn(pixCleanBackgroundToWhite(pixs.get(), nullptr, nullptr, CLEAN_GAMMA, CLEAN_BLACK_VALUE,
+                                                  CLEAN_WHITE_VALUE));
+    if (!pixn)
+    {
+        throw std::runtime_error("Leptonica failed to normalize background");
     }
 
-    outputImage = outputImageMat;
+    // Input buffer is not needed anymore, the pool can hand it out to the next call
+    pixs.reset();
+
+    prl::leptonicaToOpenCV(pixn.get(), outputImage);
 }
 
 }
\ No newline at end of file
@@ -27,17 +27,22 @@
 
 #include <opencv2/core/core.hpp>
 
+#include "backgroundNormalization.h"
+
 namespace prl
 {
 /*!
  * \brief Clean image background to white color.
  * \param[in] inputImage Input image.
  * \param[out] outputImage Output image.
- * \details Implementation is based on Leptonica library
+ * \param[in] method Implementation to use.
+ * \details Background is normalized (see backgroundNormalization()), then values are stretched
+ * so that 70 becomes black and 170 becomes white.
  * \note Implementation of this procedure is based on
  * <a href="http://www.leptonica.com/">Leptonica library</a>..
  */
-    CV_EXPORTS void cleanBackgroundToWhite(const cv::Mat& inputImage, cv::Mat& outputImage);
+    CV_EXPORTS void cleanBackgroundToWhite(const cv::Mat& inputImage, cv::Mat& outputImage,
+                                           BackgroundNormalizationMethod method = BackgroundNormalizationMethod::NATIVE);
 }
 
 #endif //PRLIB_CLEANBACKGROUNDTOWHITE_H
@@ -24,27 +24,40 @@
 
 #include "basicDeblur.h"
 
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
 #include <vector>
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
-void prl::basicDeblur(const cv::Mat& inputImage, cv::Mat& outputImage,
-                      const size_t gaussianKernelSize, const double sigmaX, const double sigmaY,
-                      const double imageWeight)
+//! Kernel size used by cv::GaussianBlur for floating point images
+static int defaultKernelSize(double sigma)
 {
-    cv::Mat inputImageMat = inputImage;
+    return std::max(1, cvRound(sigma * 4 * 2 + 1) | 1);
+}
 
-    if (inputImageMat.empty())
-    {
-        throw std::invalid_argument("Input image for deblurring is empty");
-    }
+/*!
+ * Unsharp mask of 8-bit image without float copies: cv::GaussianBlur runs its fixed-point
+ * SIMD path on interleaved channels, cv::addWeighted rounds and saturates.
+ */
+static void integerUnsharpMask(const cv::Mat& inputImage, cv::Mat& outputImage, const cv::Size& ksize,
+                               double sigmaX, double sigmaY, double imageWeight)
+{
+    cv::Mat blurredImage;
+    cv::GaussianBlur(inputImage, blurredImage, ksize, sigmaX, sigmaY);
+    cv::addWeighted(inputImage, 2.0 * imageWeight, blurredImage, 2.0 * imageWeight - 2.0, 0.0, outputImage);
+}
 
+//! Reference implementation for images which are not 8-bit
+static void floatUnsharpMask(const cv::Mat& inputImage, cv::Mat& outputImage, const cv::Size& ksize,
+                             double sigmaX, double sigmaY, double imageWeight)
+{
     cv::Mat outputImageMat;
 
     std::vector<cv::Mat> channels;
-    cv::split(inputImageMat, channels);
+    cv::split(inputImage, channels);
 
     for (cv::Mat& channel : channels)
     {
@@ -52,7 +65,7 @@ void prl::basicDeblur(const cv::Mat& inputImage, cv::Mat& outputImage,
         channel.convertTo(channelfloat, CV_32F);
         cv::GaussianBlur(
                 channelfloat, channel,
-                cv::Size(gaussianKernelSize, gaussianKernelSize),
+                ksize,
                 sigmaX, sigmaY);
         cv::addWeighted(
                 channelfloat, 2.0 * imageWeight,
@@ -68,3 +81,29 @@ void prl::basicDeblur(const cv::Mat& inputImage, cv::Mat& outputImage,
 
     outputImage = outputImageMat;
 }
+
+void prl::basicDeblur(const cv::Mat& inputImage, cv::Mat& outputImage,
+                      const size_t gaussianKernelSize, const double sigmaX, const double sigmaY,
+                      const double imageWeight)
+{
+    if (inputImage.empty())
+    {
+        throw std::invalid_argument("Input image for deblurring is empty");
+    }
+
+    if (inputImage.depth() != CV_8U || sigmaX <= 0)
+    {
+        floatUnsharpMask(inputImage, outputImage,
+                         cv::Size(static_cast<int>(gaussianKernelSize), static_cast<int>(gaussianKernelSize)),
+                         sigmaX, sigmaY, imageWeight);
+        return;
+    }
+
+    // Same kernel as cv::GaussianBlur on CV_32F would choose
+    const double sigmaYChecked = sigmaY > 0 ? sigmaY : sigmaX;
+    const cv::Size ksize = gaussianKernelSize > 0
+                           ? cv::Size(static_cast<int>(gaussianKernelSize), static_cast<int>(gaussianKernelSize))
+                           : cv::Size(defaultKernelSize(sigmaX), defaultKernelSize(sigmaYChecked));
+
+    integerUnsharpMask(inputImage, outputImage, ksize, sigmaX, sigmaYChecked, imageWeight);
+}
@@ -0,0 +1,162 @@
+/*
+    MIT License
+
+    Copyright (c) 2017 Alexander Zaitsev
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "deblurRichardsonLucy.h"
+
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "deconvolutionUtils.h"
+
+//! Least recently used plan is evicted when the cache holds more plans than this
+static const size_t RICHARDSON_LUCY_PLAN_CACHE_CAPACITY = 16;
+//! Reblurred estimate is clamped to this value to avoid division by zero
+static const float RICHARDSON_LUCY_EPSILON = 1e-3f;
+
+static void checkRichardsonLucyParameters(int filterKernelWidth, int filterKernelHeight, double sigmaGauss)
+{
+    if (!((filterKernelWidth > 0) && (filterKernelHeight > 0)))
+    {
+        throw std::invalid_argument("Parameters must satisfy the following condition: "
+                                    "( (filterKernelWidth > 0) && (filterKernelHeight > 0) ) ");
+    }
+
+    if (sigmaGauss <= 0)
+    {
+        throw std::invalid_argument("Parameters must satisfy the following condition: ( sigmaGauss > 0 ) ");
+    }
+}
+
+prl::RichardsonLucyPlan::RichardsonLucyPlan(const cv::Size& imageSize, int filterKernelWidth,
+                                            int filterKernelHeight, double sigmaGauss)
+    : m_imageSize(imageSize)
+{
+    checkRichardsonLucyParameters(filterKernelWidth, filterKernelHeight, sigmaGauss);
+
+    deconvolutionDftLayout(imageSize, filterKernelWidth, filterKernelHeight, m_dftSize, m_offset);
+
+    m_psfSpectrum = gaussianPsfSpectrum(m_dftSize, filterKernelWidth, filterKernelHeight, sigmaGauss);
+}
+
+void prl::RichardsonLucyPlan::applyToChannel(const cv::Mat& inputChannel, cv::Mat& outputChannel, int iterations,
+                                             double minRelativeUpdate) const
+{
+    cv::Mat observed;
+    padForDft(inputChannel, m_dftSize, m_offset, observed);
+
+    cv::Mat estimate = observed.clone();
+    cv::Mat spectrum, reblurred, correction, previous;
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        // reblurred = estimate * PSF
+        cv::dft(estimate, spectrum);
+        cv::mulSpectrums(spectrum, m_psfSpectrum, spectrum, 0);
+        cv::idft(spectrum, reblurred, cv::DFT_SCALE | cv::DFT_REAL_OUTPUT);
+
+        // correction = (observed / reblurred) correlated with PSF
+        cv::max(reblurred, RICHARDSON_LUCY_EPSILON, reblurred);
+        cv::divide(observed, reblurred, correction);
+        cv::dft(correction, spectrum);
+        cv::mulSpectrums(spectrum, m_psfSpectrum, spectrum, 0, true);
+        cv::idft(spectrum, correction, cv::DFT_SCALE | cv::DFT_REAL_OUTPUT);
+
+        estimate.copyTo(previous);
+        cv::multiply(estimate, correction, estimate);
+        // Ringing of DFT may give small negative values
+        cv::max(estimate, 0.0f, estimate);
+
+        const double estimateNorm = cv::norm(previous, cv::NORM_L1);
+        if (estimateNorm > 0 && cv::norm(estimate, previous, cv::NORM_L1) / estimateNorm < minRelativeUpdate)
+        {
+            break;
+        }
+    }
+
+    estimate(cv::Rect(m_offset, m_imageSize)).convertTo(outputChannel, inputChannel.depth());
+}
+
+void prl::RichardsonLucyPlan::apply(const cv::Mat& inputImage, cv::Mat& outputImage, int iterations,
+                                    double minRelativeUpdate) const
+{
+    if (inputImage.size() != m_imageSize)
+    {
+        throw std::invalid_argument("Image size differs from Richardson-Lucy plan size");
+    }
+
+    std::vector<cv::Mat> inputImageChannels;
+    cv::split(inputImage, inputImageChannels);
+
+    std::vector<cv::Mat> resultImageChannels(inputImageChannels.size());
+    cv::parallel_for_(cv::Range(0, static_cast<int>(inputImageChannels.size())), [&](const cv::Range& range)
+    {
+        for (int i = range.start; i < range.end; ++i)
+        {
+            applyToChannel(inputImageChannels[i], resultImageChannels[i], iterations, minRelativeUpdate);
+        }
+    });
+
+    cv::merge(resultImageChannels, outputImage);
+}
+
+std::shared_ptr<const prl::RichardsonLucyPlan> prl::getRichardsonLucyPlan(
+        const cv::Size& imageSize, int filterKernelWidth, int filterKernelHeight, double sigmaGauss)
+{
+    typedef std::tuple<int, int, int, int, double> PlanKey;
+
+    static PlanCache<PlanKey, RichardsonLucyPlan> plans(RICHARDSON_LUCY_PLAN_CACHE_CAPACITY);
+
+    const PlanKey key(imageSize.width, imageSize.height, filterKernelWidth, filterKernelHeight, sigmaGauss);
+
+    return plans.get(key, [&]()
+    {
+        return std::make_shared<const RichardsonLucyPlan>(imageSize, filterKernelWidth, filterKernelHeight,
+                                                          sigmaGauss);
+    });
+}
+
+void prl::deblurRichardsonLucy(const cv::Mat& inputImage, cv::Mat& outputImage,
+                               int filterKernelWidth, int filterKernelHeight, double sigmaGauss,
+                               int iterations, double minRelativeUpdate)
+{
+    if (inputImage.empty())
+    {
+        throw std::invalid_argument("Input image for deblurring is empty");
+    }
+
+    if (iterations < 0)
+    {
+        throw std::invalid_argument("Parameters must satisfy the following condition: ( iterations >= 0 ) ");
+    }
+
+    checkRichardsonLucyParameters(filterKernelWidth, filterKernelHeight, sigmaGauss);
+
+    getRichardsonLucyPlan(inputImage.size(), filterKernelWidth, filterKernelHeight, sigmaGauss)
+            ->apply(inputImage, outputImage, iterations, minRelativeUpdate);
+}
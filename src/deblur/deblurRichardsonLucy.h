@@ -0,0 +1,102 @@
+/*
+    MIT License
+
+    Copyright (c) 2017 Alexander Zaitsev
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef PRLIB_deblurRichardsonLucy_h
+#define PRLIB_deblurRichardsonLucy_h
+
+#include <memory>
+
+#include <opencv2/core/core.hpp>
+
+namespace prl
+{
+
+/*!
+ * \brief Precomputed Richardson-Lucy deconvolution for images of one size.
+ * \details PSF is Gaussian. Image is padded with reflected border to the size which is fast for DFT,
+ * PSF spectrum is stored in CCS (real DFT) format in float precision. Correlation with flipped PSF
+ * is multiplication by conjugated spectrum, so one spectrum serves both convolutions of an iteration.
+ * Plan is immutable and can be shared by threads.
+ */
+class CV_EXPORTS RichardsonLucyPlan
+{
+public:
+    RichardsonLucyPlan(const cv::Size& imageSize, int filterKernelWidth, int filterKernelHeight, double sigmaGauss);
+
+    /*!
+     * \brief Deblur image, channels are processed in parallel.
+     * \param[in] inputImage Image of plan size.
+     * \param[out] outputImage Output image of the same type.
+     * \param[in] iterations Maximal count of iterations.
+     * \param[in] minRelativeUpdate Iterations of a channel stop when L1 norm of the update relative to
+     * L1 norm of the estimate falls below this value.
+     */
+    void apply(const cv::Mat& inputImage, cv::Mat& outputImage, int iterations, double minRelativeUpdate) const;
+
+    const cv::Size& imageSize() const
+    {
+        return m_imageSize;
+    }
+
+private:
+    void applyToChannel(const cv::Mat& inputChannel, cv::Mat& outputChannel, int iterations,
+                        double minRelativeUpdate) const;
+
+    cv::Size m_imageSize;
+    cv::Size m_dftSize;
+    //! Offset of image inside padded DFT buffer
+    cv::Point m_offset;
+    //! PSF spectrum, CCS packed CV_32FC1
+    cv::Mat m_psfSpectrum;
+};
+
+/*!
+ * \brief Get plan from the cache of recently used plans or create new one.
+ * \details Cache is thread-safe, plans are keyed by all constructor parameters. It keeps 16 plans,
+ * the least recently used one is evicted to make room for a new plan.
+ */
+CV_EXPORTS std::shared_ptr<const RichardsonLucyPlan> getRichardsonLucyPlan(
+        const cv::Size& imageSize, int filterKernelWidth, int filterKernelHeight, double sigmaGauss);
+
+/*!
+ * \brief Richardson-Lucy deconvolution with Gaussian PSF.
+ * \param[in] inputImage Input image.
+ * \param[out] outputImage Output image of the same type.
+ * \param[in] filterKernelWidth PSF width.
+ * \param[in] filterKernelHeight PSF height.
+ * \param[in] sigmaGauss PSF sigma.
+ * \param[in] iterations Maximal count of iterations.
+ * \param[in] minRelativeUpdate Relative update below which iterations stop early.
+ * \details Both convolutions of every iteration are done in frequency domain.
+ */
+CV_EXPORTS void deblurRichardsonLucy(
+        const cv::Mat& inputImage,
+        cv::Mat& outputImage,
+        int filterKernelWidth = 11, int filterKernelHeight = 11,
+        double sigmaGauss = 2.0,
+        int iterations = 30,
+        double minRelativeUpdate = 0.001);
+
+}
+#endif // PRLIB_deblurRichardsonLucy_h
@@ -0,0 +1,71 @@
+/*
+    MIT License
+
+    Copyright (c) 2017 Alexander Zaitsev
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "deconvolutionUtils.h"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+void prl::deconvolutionDftLayout(const cv::Size& imageSize, int filterKernelWidth, int filterKernelHeight,
+                                 cv::Size& dftSize, cv::Point& offset)
+{
+    dftSize.width = cv::getOptimalDFTSize(imageSize.width + filterKernelWidth - 1);
+    dftSize.height = cv::getOptimalDFTSize(imageSize.height + filterKernelHeight - 1);
+    offset.x = (dftSize.width - imageSize.width) / 2;
+    offset.y = (dftSize.height - imageSize.height) / 2;
+}
+
+cv::Mat prl::gaussianPsfSpectrum(const cv::Size& dftSize, int filterKernelWidth, int filterKernelHeight,
+                                 double sigmaGauss)
+{
+    const cv::Mat kernelY = cv::getGaussianKernel(filterKernelHeight, sigmaGauss, CV_64F);
+    const cv::Mat kernelX = cv::getGaussianKernel(filterKernelWidth, sigmaGauss, CV_64F);
+
+    cv::Mat psf = cv::Mat::zeros(dftSize, CV_32FC1);
+    for (int i = 0; i < filterKernelHeight; ++i)
+    {
+        const int y = (i - filterKernelHeight / 2 + dftSize.height) % dftSize.height;
+        for (int j = 0; j < filterKernelWidth; ++j)
+        {
+            const int x = (j - filterKernelWidth / 2 + dftSize.width) % dftSize.width;
+            psf.at<float>(y, x) += static_cast<float>(kernelY.at<double>(i) * kernelX.at<double>(j));
+        }
+    }
+
+    cv::Mat spectrum;
+    cv::dft(psf, spectrum);
+
+    return spectrum;
+}
+
+void prl::padForDft(const cv::Mat& inputChannel, const cv::Size& dftSize, const cv::Point& offset, cv::Mat& padded)
+{
+    cv::Mat realChannel;
+    inputChannel.convertTo(realChannel, CV_32F);
+
+    cv::copyMakeBorder(realChannel, padded,
+                       offset.y, dftSize.height - inputChannel.rows - offset.y,
+                       offset.x, dftSize.width - inputChannel.cols - offset.x,
+                       cv::BORDER_REFLECT);
+}
@@ -0,0 +1,131 @@
+/*
+    MIT License
+
+    Copyright (c) 2017 Alexander Zaitsev
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef PRLIB_deconvolutionUtils_h
+#define PRLIB_deconvolutionUtils_h
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include <opencv2/core/core.hpp>
+
+namespace prl
+{
+
+/*!
+ * \brief Size of padded DFT buffer and offset of image inside it.
+ * \details Padding by kernel size removes wrap-around of circular convolution.
+ */
+void deconvolutionDftLayout(const cv::Size& imageSize, int filterKernelWidth, int filterKernelHeight,
+                            cv::Size& dftSize, cv::Point& offset);
+
+/*!
+ * \brief Real DFT of normalized Gaussian PSF centered at origin of DFT buffer (wrapped around).
+ * \return CCS packed CV_32FC1 spectrum.
+ */
+cv::Mat gaussianPsfSpectrum(const cv::Size& dftSize, int filterKernelWidth, int filterKernelHeight,
+                            double sigmaGauss);
+
+/*!
+ * \brief Convert channel to CV_32F and pad it with reflected border to DFT size.
+ * \param[in] inputChannel Single channel image.
+ * \param[in] dftSize Size of padded buffer, see deconvolutionDftLayout().
+ * \param[in] offset Offset of image inside padded buffer.
+ * \param[out] padded Padded CV_32FC1 image.
+ */
+void padForDft(const cv::Mat& inputChannel, const cv::Size& dftSize, const cv::Point& offset, cv::Mat& padded);
+
+/*!
+ * \brief Thread-safe cache of immutable deconvolution plans.
+ * \details Holds at most capacity plans, the least recently used one is evicted to make room for a new plan.
+ * Plans are built without lock, concurrent builders of the same plan just do extra work.
+ */
+template <typename Key, typename Plan>
+class PlanCache
+{
+public:
+    explicit PlanCache(size_t capacity) : m_capacity(capacity)
+    {
+    }
+
+    template <typename Factory>
+    std::shared_ptr<const Plan> get(const Key& key, Factory makePlan)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::shared_ptr<const Plan> plan = find(key);
+            if (plan)
+            {
+                return plan;
+            }
+        }
+
+        std::shared_ptr<const Plan> plan = makePlan();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::shared_ptr<const Plan> cachedPlan = find(key);
+        if (cachedPlan)
+        {
+            return cachedPlan;
+        }
+
+        m_plans.emplace_front(key, plan);
+        m_index[key] = m_plans.begin();
+        if (m_plans.size() > m_capacity)
+        {
+            m_index.erase(m_plans.back().first);
+            m_plans.pop_back();
+        }
+
+        return plan;
+    }
+
+private:
+    typedef std::list<std::pair<Key, std::shared_ptr<const Plan>>> PlanList;
+
+    //! Move found plan to the front, caller holds the lock
+    std::shared_ptr<const Plan> find(const Key& key)
+    {
+        auto it = m_index.find(key);
+        if (it == m_index.end())
+        {
+            return nullptr;
+        }
+
+        m_plans.splice(m_plans.begin(), m_plans, it->second);
+        return it->second->second;
+    }
+
+    const size_t m_capacity;
+    std::mutex m_mutex;
+    //! Most recently used plan first
+    PlanList m_plans;
+    std::map<Key, typename PlanList::iterator> m_index;
+};
+
+}
+#endif // PRLIB_deconvolutionUtils_h
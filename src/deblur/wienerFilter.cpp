@@ -24,23 +24,26 @@
 
 #include "wienerFilter.h"
 
-#include <cmath>
-#include <complex>
+#include <algorithm>
 #include <memory>
+#include <numeric>
 #include <stdexcept>
+#include <tuple>
 #include <vector>
 
-#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
 
-void prl::wienerFilter(cv::Mat& inputImage, cv::Mat& outputImage,
-                       int filterKernelWidth, int filterKernelHeight,
-                       double coeffWiener, double sigmaGauss)
-{
-    if (inputImage.empty())
-    {
-        throw std::invalid_argument("Input image for deblurring is empty");
-    }
+#include "blurDetection.h"
+#include "deconvolutionUtils.h"
+
+//! Least recently used plan is evicted when the cache holds more plans than this
+static const size_t WIENER_PLAN_CACHE_CAPACITY = 16;
+//! Tile margin in kernel sizes, inverse filter is wider than PSF
+static const int WIENER_TILE_MARGIN_KERNELS = 2;
 
+static void checkWienerParameters(int filterKernelWidth, int filterKernelHeight, double sigmaGauss)
+{
     if (!((filterKernelWidth > 1) && (filterKernelHeight > 1)))
     {
         throw std::invalid_argument("Parameters must satisfy the following condition: \
@@ -52,159 +55,318 @@ void prl::wienerFilter(cv::Mat& inputImage, cv::Mat& outputImage,
         throw std::invalid_argument("Parameters must satisfy the following condition: \
 			( sigmaGauss > 0 ) ");
     }
+}
 
-    int inputImageHeight = inputImage.rows;
-    int inputImageWidth = inputImage.cols;
-
-
-    //////////////////////////////////////////////////////////////////////////
-
-    cv::Mat kernelImage = cv::Mat(filterKernelHeight, filterKernelWidth, CV_64FC1);
+//! W = conj(H) / (|H|^2 + K) of a complex frequency stored as (re, im)
+static inline void wienerComplex(float& re, float& im, float coeffWiener)
+{
+    const float denominator = re * re + im * im + coeffWiener;
+    re = denominator != 0.0f ? re / denominator : 0.0f;
+    im = denominator != 0.0f ? -im / denominator : 0.0f;
+}
 
-    double sigmaSqr = sigmaGauss * sigmaGauss;
+//! W = H / (H^2 + K) of a real frequency
+static inline void wienerReal(float& re, float coeffWiener)
+{
+    const float denominator = re * re + coeffWiener;
+    re = denominator != 0.0f ? re / denominator : 0.0f;
+}
+
+/*!
+ * Wiener transfer function from CCS spectrum of PSF, computed in CCS layout.
+ * Columns of zero and (for even width) Nyquist horizontal frequency are packed vertically,
+ * other columns hold (re, im) pairs in every row. DC and Nyquist entries are real.
+ */
+static void wienerTransfer(const cv::Mat& psfSpectrum, double coeffWiener, cv::Mat& transfer)
+{
+    CV_Assert(psfSpectrum.type() == CV_32FC1);
 
-    double amplitude = 1 / (sigmaGauss * std::sqrt(2 * CV_PI));
+    const float coeff = static_cast<float>(coeffWiener);
+    const int rows = psfSpectrum.rows;
+    const int cols = psfSpectrum.cols;
+    const int pairedRowsEnd = rows % 2 == 0 ? rows - 1 : rows;
+    const int pairedColumnsEnd = cols % 2 == 0 ? cols - 1 : cols;
 
-    int halfFilterKernelWidth = filterKernelWidth / 2;
-    int halfFilterKernelHeight = filterKernelHeight / 2;
+    psfSpectrum.copyTo(transfer);
 
-    for (int i = 0; i < filterKernelHeight; ++i)
+    const int packedColumns[] = {0, cols - 1};
+    const int packedColumnsCount = cols % 2 == 0 ? 2 : 1;
+    for (int i = 0; i < packedColumnsCount; ++i)
     {
-        int y = i - halfFilterKernelHeight;
-        const double ySqr = y * y;
-
-        for (int j = 0; j < filterKernelWidth; ++j)
+        const int x = packedColumns[i];
+        wienerReal(transfer.at<float>(0, x), coeff);
+        for (int y = 1; y + 1 < pairedRowsEnd; y += 2)
         {
-            int x = j - halfFilterKernelWidth;
-            double xSqr = x * x;
-
-            double exponent = static_cast<double>((ySqr + xSqr) / (2.0 * sigmaSqr));
+            wienerComplex(transfer.at<float>(y, x), transfer.at<float>(y + 1, x), coeff);
+        }
+        if (rows % 2 == 0)
+        {
+            wienerReal(transfer.at<float>(rows - 1, x), coeff);
+        }
+    }
 
-            kernelImage.at<double>(i, j) = amplitude * exp(-exponent);
+    for (int y = 0; y < rows; ++y)
+    {
+        float* row = transfer.ptr<float>(y);
+        for (int x = 1; x + 1 < pairedColumnsEnd; x += 2)
+        {
+            wienerComplex(row[x], row[x + 1], coeff);
         }
     }
+}
 
-    //////////////////////////////////////////////////////////////////////////
+static void forwardChannel(const cv::Mat& inputChannel, const cv::Size& dftSize, const cv::Point& offset,
+                           cv::Mat& spectrum)
+{
+    cv::Mat padded;
+    prl::padForDft(inputChannel, dftSize, offset, padded);
 
-    cv::Mat kernelMatrix = cv::Mat::zeros(inputImageHeight, inputImageWidth, CV_64FC1);
+    cv::dft(padded, spectrum);
+}
 
-    {
-        double sumKernelElements = 0.0;
+static void inverseChannel(const cv::Mat& spectrum, const cv::Mat& transfer, const cv::Rect& imageRect, int depth,
+                           cv::Mat& outputChannel)
+{
+    cv::Mat filteredSpectrum;
+    cv::mulSpectrums(spectrum, transfer, filteredSpectrum, 0);
 
-        int inputImageWidthHalf = inputImageWidth / 2;
-        int inputImageHeightHalf = inputImageHeight / 2;
+    cv::Mat padded;
+    cv::idft(filteredSpectrum, padded, cv::DFT_SCALE | cv::DFT_REAL_OUTPUT);
 
-        /*std::shared_ptr<double[]> kernelTempMatrix(
-            new double[inputImageWidth * inputImageWidth], std::default_delete<double[]>());*/
+    padded(imageRect).convertTo(outputChannel, depth);
+}
 
-        std::vector<double> kernelTempMatrix(inputImageWidth * inputImageWidth);
+//! CCS spectra of padded channels, channels are processed in parallel
+static void forwardSpectra(const cv::Mat& inputImage, const cv::Size& dftSize, const cv::Point& offset,
+                           std::vector<cv::Mat>& spectra)
+{
+    std::vector<cv::Mat> inputImageChannels;
+    cv::split(inputImage, inputImageChannels);
 
-        for (int y = 0; y < inputImageHeight; ++y)
+    spectra.resize(inputImageChannels.size());
+    cv::parallel_for_(cv::Range(0, static_cast<int>(inputImageChannels.size())), [&](const cv::Range& range)
+    {
+        for (int i = range.start; i < range.end; ++i)
         {
-            for (int x = 0; x < inputImageWidth; ++x)
-            {
-                int index = y * inputImageWidth + x;
-                double value = 0.0;
-
-                // if we are in the kernel area (of small kernelImage), then take pixel values.
-                // Otherwise keep 0
-                if (std::abs(x - inputImageWidthHalf) < (filterKernelWidth - 2) / 2 &&
-                    std::abs(y - inputImageHeightHalf) < (filterKernelHeight - 2) / 2)
-                {
-                    int xLocal = x - (inputImageWidth - filterKernelWidth) / 2;
-                    int yLocal = y - (inputImageHeight - filterKernelHeight) / 2;
-
-                    value = kernelImage.at<double>(yLocal, xLocal);
-                }
-
-                kernelTempMatrix[index] = value;
-                sumKernelElements += std::abs(value);
-            }
+            forwardChannel(inputImageChannels[i], dftSize, offset, spectra[i]);
         }
+    });
+}
 
-        // Zero-protection
-        if (sumKernelElements == 0.0)
+//! Filter spectra with transfer function and crop image part of the result
+static void inverseSpectra(const std::vector<cv::Mat>& spectra, const cv::Mat& transfer, const cv::Rect& imageRect,
+                           int depth, cv::Mat& outputImage)
+{
+    std::vector<cv::Mat> resultImageChannels(spectra.size());
+    cv::parallel_for_(cv::Range(0, static_cast<int>(spectra.size())), [&](const cv::Range& range)
+    {
+        for (int i = range.start; i < range.end; ++i)
         {
-            sumKernelElements = 1.0;
+            inverseChannel(spectra[i], transfer, imageRect, depth, resultImageChannels[i]);
         }
+    });
 
-        // Normalize
-        double sumKernelElementsBack = 1.0 / sumKernelElements;
-        for (int i = 0; i < inputImageWidth * inputImageHeight; ++i)
-        {
-            kernelTempMatrix[i] *= sumKernelElementsBack;
-        }
+    cv::merge(resultImageChannels, outputImage);
+}
+
+prl::WienerFilterPlan::WienerFilterPlan(const cv::Size& imageSize, int filterKernelWidth, int filterKernelHeight,
+                                        double coeffWiener, double sigmaGauss)
+    : m_imageSize(imageSize)
+{
+    checkWienerParameters(filterKernelWidth, filterKernelHeight, sigmaGauss);
 
-        // Translate kernel, because we don't use centered FFT
-        // (by multiply input image on pow(-1, x + y))
-        // so we need to translate kernel by (width / 2) to the left
-        // and by (height / 2) to the up
-        for (size_t y = 0; y < inputImageHeight; ++y)
+    deconvolutionDftLayout(imageSize, filterKernelWidth, filterKernelHeight, m_dftSize, m_offset);
+
+    // One real DFT of PSF, transfer function is computed in the same CCS layout as image spectra
+    wienerTransfer(gaussianPsfSpectrum(m_dftSize, filterKernelWidth, filterKernelHeight, sigmaGauss),
+                   coeffWiener, m_transfer);
+}
+
+void prl::WienerFilterPlan::forward(const cv::Mat& inputImage, std::vector<cv::Mat>& spectra) const
+{
+    if (inputImage.size() != m_imageSize)
+    {
+        throw std::invalid_argument("Image size differs from Wiener filter plan size");
+    }
+
+    forwardSpectra(inputImage, m_dftSize, m_offset, spectra);
+}
+
+void prl::WienerFilterPlan::inverse(const std::vector<cv::Mat>& spectra, int depth, cv::Mat& outputImage) const
+{
+    for (const cv::Mat& spectrum : spectra)
+    {
+        if (spectrum.size() != m_dftSize)
         {
-            for (size_t x = 0; x < inputImageWidth; ++x)
-            {
-                int xTranslated = (x + inputImageWidth / 2) % inputImageWidth;
-                int yTranslated = (y + inputImageHeight / 2) % inputImageHeight;
-                (reinterpret_cast<double*>(kernelMatrix.data))[y * inputImageWidth + x] =
-                        kernelTempMatrix[yTranslated * inputImageWidth + xTranslated];
-
-// 				kernelMatrix.at<double>(y, x) = 
-// 					kernelTempMatrix.get()[yTranslated * inputImageWidth + xTranslated];
-            }
+            throw std::invalid_argument("Spectrum size differs from Wiener filter plan DFT size");
         }
+    }
+
+    inverseSpectra(spectra, m_transfer, cv::Rect(m_offset, m_imageSize), depth, outputImage);
+}
 
+void prl::WienerFilterPlan::apply(const cv::Mat& inputImage, cv::Mat& outputImage) const
+{
+    std::vector<cv::Mat> spectra;
+    forward(inputImage, spectra);
+    inverse(spectra, inputImage.depth(), outputImage);
+}
+
+std::shared_ptr<const prl::WienerFilterPlan> prl::getWienerFilterPlan(
+        const cv::Size& imageSize, int filterKernelWidth, int filterKernelHeight,
+        double coeffWiener, double sigmaGauss)
+{
+    typedef std::tuple<int, int, int, int, double, double> PlanKey;
+
+    static PlanCache<PlanKey, WienerFilterPlan> plans(WIENER_PLAN_CACHE_CAPACITY);
+
+    const PlanKey key(imageSize.width, imageSize.height, filterKernelWidth, filterKernelHeight,
+                      coeffWiener, sigmaGauss);
+
+    return plans.get(key, [&]()
+    {
+        return std::make_shared<const WienerFilterPlan>(imageSize, filterKernelWidth, filterKernelHeight,
+                                                        coeffWiener, sigmaGauss);
+    });
+}
+
+void prl::wienerFilter(const cv::Mat& inputImage, cv::Mat& outputImage,
+                       int filterKernelWidth, int filterKernelHeight,
+                       double coeffWiener, double sigmaGauss)
+{
+    if (inputImage.empty())
+    {
+        throw std::invalid_argument("Input image for deblurring is empty");
     }
 
-    cv::Mat kernelFFT;
-    cv::dft(kernelMatrix, kernelFFT, cv::DFT_COMPLEX_OUTPUT);
+    checkWienerParameters(filterKernelWidth, filterKernelHeight, sigmaGauss);
+
+    getWienerFilterPlan(inputImage.size(), filterKernelWidth, filterKernelHeight, coeffWiener, sigmaGauss)
+            ->apply(inputImage, outputImage);
+}
+
+void prl::wienerFilterTiled(const cv::Mat& inputImage, cv::Mat& outputImage,
+                            int filterKernelWidth, int filterKernelHeight,
+                            double coeffWiener, double sigmaGauss, int tileSize)
+{
+    if (inputImage.empty())
+    {
+        throw std::invalid_argument("Input image for deblurring is empty");
+    }
 
-    //! Rewrite this code using OpenCV functions
-    for (int y = 0; y < inputImageHeight; ++y)
+    if (tileSize <= 0)
     {
-        for (int x = 0; x < inputImageWidth; ++x)
+        throw std::invalid_argument("Parameters must satisfy the following condition: ( tileSize > 0 ) ");
+    }
+
+    checkWienerParameters(filterKernelWidth, filterKernelHeight, sigmaGauss);
+
+    const cv::Size margin(WIENER_TILE_MARGIN_KERNELS * filterKernelWidth,
+                          WIENER_TILE_MARGIN_KERNELS * filterKernelHeight);
+    const cv::Size coreSize(std::min(tileSize, inputImage.cols), std::min(tileSize, inputImage.rows));
+    const cv::Size windowSize(coreSize.width + 2 * margin.width, coreSize.height + 2 * margin.height);
+
+    const std::shared_ptr<const WienerFilterPlan> plan =
+            getWienerFilterPlan(windowSize, filterKernelWidth, filterKernelHeight, coeffWiener, sigmaGauss);
+
+    const int tilesX = (inputImage.cols + coreSize.width - 1) / coreSize.width;
+    const int tilesY = (inputImage.rows + coreSize.height - 1) / coreSize.height;
+
+    cv::Mat result(inputImage.size(), inputImage.type());
+
+    cv::parallel_for_(cv::Range(0, tilesX * tilesY), [&](const cv::Range& range)
+    {
+        cv::Mat window, filteredWindow;
+
+        for (int tile = range.start; tile < range.end; ++tile)
         {
-            double pointValueReal = kernelFFT.at<std::complex<double> >(y, x).real();
-            double pointValueImag = kernelFFT.at<std::complex<double> >(y, x).imag();
+            const cv::Rect core(cv::Point((tile % tilesX) * coreSize.width, (tile / tilesX) * coreSize.height),
+                                coreSize);
+            const cv::Rect clippedCore = core & cv::Rect(cv::Point(0, 0), inputImage.size());
 
-            double pointValueRealSqr = pointValueReal * pointValueReal;
-            double pointValueImagSqr = pointValueImag * pointValueImag;
+            // Window around the core, parts outside the image are reflected like in the global filter
+            const cv::Rect windowRect(core.x - margin.width, core.y - margin.height,
+                                      windowSize.width, windowSize.height);
+            const cv::Rect clippedWindow = windowRect & cv::Rect(cv::Point(0, 0), inputImage.size());
 
-            double energyValue = pointValueRealSqr + pointValueImagSqr;
+            cv::copyMakeBorder(inputImage(clippedWindow), window,
+                               clippedWindow.y - windowRect.y, windowRect.br().y - clippedWindow.br().y,
+                               clippedWindow.x - windowRect.x, windowRect.br().x - clippedWindow.br().x,
+                               cv::BORDER_REFLECT);
 
-            double wienerValue = pointValueReal / (energyValue + coeffWiener);
+            plan->apply(window, filteredWindow);
 
-            kernelFFT.at<std::complex<double> >(y, x) *= wienerValue;
+            filteredWindow(cv::Rect(margin.width, margin.height, clippedCore.width, clippedCore.height))
+                    .copyTo(result(clippedCore));
         }
-    }
+    });
 
-    //////////////////////////////////////////////////////////////////////////
+    outputImage = result;
+}
 
+size_t prl::wienerFilterSweep(const cv::Mat& inputImage, const std::vector<WienerParameters>& parameters,
+                              std::vector<double>& sharpness, cv::Mat& bestImage,
+                              int filterKernelWidth, int filterKernelHeight)
+{
+    if (inputImage.empty())
+    {
+        throw std::invalid_argument("Input image for deblurring is empty");
+    }
 
-    std::vector<cv::Mat> inputImageChannels, resultImageChannels;
-    cv::split(inputImage, inputImageChannels);
+    if (parameters.empty())
+    {
+        throw std::invalid_argument("Parameter list for Wiener filter sweep is empty");
+    }
 
-    for (cv::Mat& inputChannel : inputImageChannels)
+    for (const WienerParameters& parameter : parameters)
     {
-        cv::Mat realTypeInputChannel;
-        inputChannel.convertTo(realTypeInputChannel, CV_64F);
+        checkWienerParameters(filterKernelWidth, filterKernelHeight, parameter.sigmaGauss);
+    }
 
-        cv::Mat inputChannelFFT = cv::Mat::zeros(realTypeInputChannel.size(), realTypeInputChannel.type());
-        cv::dft(realTypeInputChannel, inputChannelFFT, cv::DFT_COMPLEX_OUTPUT);
+    // Transfer functions are built here and not cached, a sweep would only evict plans of other callers
+    cv::Size dftSize;
+    cv::Point offset;
+    deconvolutionDftLayout(inputImage.size(), filterKernelWidth, filterKernelHeight, dftSize, offset);
+    const cv::Rect imageRect(offset, inputImage.size());
 
-        //inputChannelFFT *= 1.0 / (inputImageWidth * inputImageHeight);
+    std::vector<cv::Mat> spectra;
+    forwardSpectra(inputImage, dftSize, offset, spectra);
 
-        cv::Mat outputChannelFFT;
-        cv::mulSpectrums(inputChannelFFT, kernelFFT, outputChannelFFT, 0);
+    // Parameter sets with the same sigma are visited together and share one PSF spectrum
+    std::vector<size_t> order(parameters.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&parameters](size_t first, size_t second)
+    {
+        return parameters[first].sigmaGauss < parameters[second].sigmaGauss;
+    });
 
-        cv::Mat complexTypeResultChannel;
-        cv::idft(outputChannelFFT, complexTypeResultChannel, cv::DFT_SCALE);
+    sharpness.assign(parameters.size(), 0.0);
 
-        std::vector<cv::Mat> resultRealTypeSubchannels;
-        cv::split(complexTypeResultChannel, resultRealTypeSubchannels);
+    size_t bestIndex = order.front();
+    cv::Mat psfSpectrum, transfer, result;
+    for (size_t n = 0; n < order.size(); ++n)
+    {
+        const size_t i = order[n];
+        if (n == 0 || parameters[i].sigmaGauss != parameters[order[n - 1]].sigmaGauss)
+        {
+            psfSpectrum = gaussianPsfSpectrum(dftSize, filterKernelWidth, filterKernelHeight,
+                                              parameters[i].sigmaGauss);
+        }
+
+        wienerTransfer(psfSpectrum, parameters[i].coeffWiener, transfer);
+        inverseSpectra(spectra, transfer, imageRect, inputImage.depth(), result);
+        sharpness[i] = laplacianVariance(result);
 
-        resultRealTypeSubchannels[0].convertTo(resultRealTypeSubchannels[0], CV_8UC1);
-        resultImageChannels.push_back(resultRealTypeSubchannels[0]);
+        // Ties go to the first parameter set in the caller's order
+        if (n == 0 || sharpness[i] > sharpness[bestIndex] ||
+            (sharpness[i] == sharpness[bestIndex] && i < bestIndex))
+        {
+            bestIndex = i;
+            // Hand the buffer over to bestImage, the next inverse pass allocates a new one
+            bestImage = result;
+            result = cv::Mat();
+        }
     }
 
-    cv::merge(resultImageChannels, outputImage);
-}
\ No newline at end of file
+    return bestIndex;
+}
@@ -3,15 +3,128 @@
 
 #include <opencv2/core/core.hpp>
 
+#include <memory>
+#include <vector>
+
 namespace prl
 {
 
-void wienerFilter(
-		cv::Mat& inputImage,
+/*!
+ * \brief Precomputed Wiener deconvolution for images of one size.
+ * \details Gaussian PSF is deconvolved with transfer function conj(H) / (|H|^2 + K).
+ * Image is padded with reflected border to the size which is fast for DFT, the transfer function is
+ * stored in CCS (real DFT) format in float precision. Plan is immutable and can be shared by threads.
+ */
+class CV_EXPORTS WienerFilterPlan
+{
+public:
+    WienerFilterPlan(const cv::Size& imageSize, int filterKernelWidth, int filterKernelHeight,
+                     double coeffWiener, double sigmaGauss);
+
+    /*!
+     * \brief Deblur image, channels are processed in parallel.
+     * \param[in] inputImage Image of plan size.
+     * \param[out] outputImage Output image of the same type.
+     */
+    void apply(const cv::Mat& inputImage, cv::Mat& outputImage) const;
+
+    /*!
+     * \brief Forward transform of padded channels.
+     * \param[in] inputImage Image of plan size.
+     * \param[out] spectra CCS spectrum of every channel. Spectra depend only on image and kernel size,
+     * so they can be passed to inverse() of any plan with the same sizes.
+     */
+    void forward(const cv::Mat& inputImage, std::vector<cv::Mat>& spectra) const;
+
+    /*!
+     * \brief Apply transfer function to spectra and transform them back.
+     * \param[in] spectra Spectra from forward(), they are not modified.
+     * \param[in] depth Depth of output image.
+     * \param[out] outputImage Output image.
+     */
+    void inverse(const std::vector<cv::Mat>& spectra, int depth, cv::Mat& outputImage) const;
+
+    const cv::Size& imageSize() const
+    {
+        return m_imageSize;
+    }
+
+    const cv::Size& dftSize() const
+    {
+        return m_dftSize;
+    }
+
+private:
+    cv::Size m_imageSize;
+    cv::Size m_dftSize;
+    //! Offset of image inside padded DFT buffer
+    cv::Point m_offset;
+    //! Wiener transfer function, CCS packed CV_32FC1
+    cv::Mat m_transfer;
+};
+
+/*!
+ * \brief Get plan from the cache of recently used plans or create new one.
+ * \details Cache is thread-safe, plans are keyed by all constructor parameters. It keeps 16 plans,
+ * the least recently used one is evicted to make room for a new plan.
+ */
+CV_EXPORTS std::shared_ptr<const WienerFilterPlan> getWienerFilterPlan(
+        const cv::Size& imageSize, int filterKernelWidth, int filterKernelHeight,
+        double coeffWiener, double sigmaGauss);
+
+CV_EXPORTS void wienerFilter(
+		const cv::Mat& inputImage,
 		cv::Mat& outputImage,
 		int filterKernelWidth = 11, int filterKernelHeight = 11,
 		double coeffWiener = 1,
 		double sigmaGauss = 5);
 
+/*!
+ * \brief Parameters of Wiener deconvolution tried by wienerFilterSweep().
+ */
+struct WienerParameters
+{
+    double sigmaGauss;
+    double coeffWiener;
+};
+
+/*!
+ * \brief Deblur image with several parameter sets and choose the sharpest result.
+ * \param[in] inputImage Input image.
+ * \param[in] parameters Parameter sets to try, must not be empty.
+ * \param[out] sharpness Laplacian variance of result for each parameter set.
+ * \param[out] bestImage Result with the highest sharpness.
+ * \return Index of the best parameter set.
+ * \details Forward DFT of each channel is computed once. Transfer functions are built locally and do not
+ * go through the plan cache: one real DFT of the PSF per distinct sigmaGauss, then every parameter set
+ * costs element-wise transfer computation, spectrum multiplication and inverse DFT of each channel.
+ * Parameter sets are processed grouped by sigmaGauss.
+ */
+CV_EXPORTS size_t wienerFilterSweep(
+		const cv::Mat& inputImage,
+		const std::vector<WienerParameters>& parameters,
+		std::vector<double>& sharpness,
+		cv::Mat& bestImage,
+		int filterKernelWidth = 11, int filterKernelHeight = 11);
+
+/*!
+ * \brief Wiener deconvolution of large images by independent tiles (overlap-save).
+ * \param[in] inputImage Input image.
+ * \param[out] outputImage Output image of the same type.
+ * \param[in] tileSize Side of the tile part which is written to output.
+ * \details Every tile is extended by margin of twice the kernel size, filtered with one shared plan
+ * and only its central part is kept, so memory use does not depend on image size.
+ * Tiles are processed in parallel. Away from image borders result matches wienerFilter() within 1-3 gray
+ * levels for coeffWiener 1 and 0.1 (tests/wienerFilterTiled_test.cpp). Smaller coeffWiener widens the
+ * inverse filter beyond the margin, at 0.01 tiles differ by tens of gray levels.
+ */
+CV_EXPORTS void wienerFilterTiled(
+		const cv::Mat& inputImage,
+		cv::Mat& outputImage,
+		int filterKernelWidth = 11, int filterKernelHeight = 11,
+		double coeffWiener = 1,
+		double sigmaGauss = 5,
+		int tileSize = 512);
+
 }
 #endif // PRLIB_wienerFilter_h
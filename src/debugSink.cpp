@@ -0,0 +1,81 @@
+/*
+    MIT License
+
+    Copyright (c) 2017 Alexander Zaitsev
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "debugSink.h"
+
+#include <atomic>
+#include <mutex>
+#include <utility>
+
+#include <opencv2/highgui/highgui.hpp>
+
+static std::mutex debugSinkMutex;
+static prl::DebugSink debugSink;
+//! Mirrors whether debugSink is set, so that disabled check does not lock
+static std::atomic<bool> debugSinkEnabled(false);
+
+void prl::setDebugSink(DebugSink sink)
+{
+    std::lock_guard<std::mutex> lock(debugSinkMutex);
+    debugSinkEnabled.store(static_cast<bool>(sink), std::memory_order_release);
+    debugSink = std::move(sink);
+}
+
+void prl::setDebugDirectory(const std::string& directory)
+{
+    setDebugSink([directory](const std::string& stage, const cv::Mat& image)
+                 {
+                     cv::imwrite(directory + "/" + stage + ".png", image);
+                 });
+}
+
+void prl::disableDebugSink()
+{
+    setDebugSink(DebugSink());
+}
+
+bool prl::isDebugSinkEnabled()
+{
+    return debugSinkEnabled.load(std::memory_order_acquire);
+}
+
+void prl::publishDebugImage(const std::string& stage, const cv::Mat& image)
+{
+    if (!isDebugSinkEnabled())
+    {
+        return;
+    }
+
+    //! Sink is called without lock, so it may publish images itself or be slow
+    DebugSink sink;
+    {
+        std::lock_guard<std::mutex> lock(debugSinkMutex);
+        sink = debugSink;
+    }
+
+    if (sink)
+    {
+        sink(stage, image);
+    }
+}
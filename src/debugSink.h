@@ -0,0 +1,84 @@
+/*
+    MIT License
+
+    Copyright (c) 2017 Alexander Zaitsev
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef PRLIB_DEBUGSINK_HPP
+#define PRLIB_DEBUGSINK_HPP
+
+#include <functional>
+#include <string>
+
+#include <opencv2/core/core.hpp>
+
+namespace prl
+{
+/*!
+ * \brief Receiver of intermediate images published by processing stages.
+ * \details stage is a short name like "houghLine_canny", image is valid only during the call.
+ * Sink may be called concurrently from several threads.
+ */
+typedef std::function<void(const std::string& stage, const cv::Mat& image)> DebugSink;
+
+/*!
+ * \brief Install debug sink, empty sink disables publishing.
+ */
+CV_EXPORTS void setDebugSink(DebugSink sink);
+
+/*!
+ * \brief Install debug sink which writes every image to directory as <stage>.png.
+ */
+CV_EXPORTS void setDebugDirectory(const std::string& directory);
+
+/*!
+ * \brief Remove debug sink.
+ */
+CV_EXPORTS void disableDebugSink();
+
+/*!
+ * \brief Check whether debug sink is installed, stages skip building visualizations otherwise.
+ */
+CV_EXPORTS bool isDebugSinkEnabled();
+
+/*!
+ * \brief Pass image to debug sink if it is installed.
+ */
+CV_EXPORTS void publishDebugImage(const std::string& stage, const cv::Mat& image);
+}
+
+//! Debug publishing is compiled out with PRLIB_DISABLE_DEBUG_SINK, otherwise it costs one branch when disabled
+#ifdef PRLIB_DISABLE_DEBUG_SINK
+#define PRL_DEBUG_ENABLED() false
+#else
+#define PRL_DEBUG_ENABLED() prl::isDebugSinkEnabled()
+#endif
+
+#define PRL_DEBUG_IMAGE(stage, image)                 \
+    do                                                \
+    {                                                 \
+        if (PRL_DEBUG_ENABLED())                      \
+        {                                             \
+            prl::publishDebugImage((stage), (image)); \
+        }                                             \
+    } while (false)
+
+#endif //PRLIB_DEBUGSINK_HPP
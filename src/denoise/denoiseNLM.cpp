@@ -24,9 +24,144 @@
 
 #include "denoiseNLM.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/photo/photo.hpp>
 
+//! Noise is estimated on image subsampled to this size
+static const int NOISE_ESTIMATION_MAX_SIDE = 1024;
+//! Range of NLM h parameter chosen by denoiseAdaptive
+static const double ADAPTIVE_MIN_STRENGTH = 3.0;
+static const double ADAPTIVE_MAX_STRENGTH = 20.0;
+//! Median absolute deviation to sigma of normal distribution
+static const double MAD_TO_SIGMA = 1.0 / 0.6745;
+//! L2 norm of Immerkaer's noise estimation mask
+static const double NOISE_MASK_NORM = 6.0;
+
+static std::atomic<size_t> processedCount(0);
+static std::atomic<size_t> skippedCount(0);
+
 void prl::denoise(const cv::Mat& inputImage, cv::Mat& outputImage, double strength)
 {
-    cv::fastNlMeansDenoisingColored(inputImage, outputImage, strength);
-}
\ No newline at end of file
+    if (inputImage.empty())
+    {
+        throw std::invalid_argument("Input image for denoising is empty");
+    }
+
+    if (inputImage.channels() == 1)
+    {
+        cv::fastNlMeansDenoising(inputImage, outputImage, static_cast<float>(strength));
+    }
+    else
+    {
+        cv::fastNlMeansDenoisingColored(inputImage, outputImage, static_cast<float>(strength));
+    }
+}
+
+double prl::estimateNoiseLevel(const cv::Mat& inputImage)
+{
+    if (inputImage.empty())
+    {
+        throw std::invalid_argument("Input image for noise estimation is empty");
+    }
+
+    // Histogram below is sized for high-pass response of 8-bit data
+    if (inputImage.depth() != CV_8U)
+    {
+        throw std::invalid_argument("Noise estimation supports only 8-bit images");
+    }
+
+    cv::Mat gray;
+    if (inputImage.channels() == 1)
+    {
+        gray = inputImage;
+    }
+    else
+    {
+        cv::cvtColor(inputImage, gray, inputImage.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+    }
+
+    // Nearest neighbour subsampling does not average noise out
+    const int maxSide = std::max(gray.cols, gray.rows);
+    if (maxSide > NOISE_ESTIMATION_MAX_SIDE)
+    {
+        const int factor = (maxSide + NOISE_ESTIMATION_MAX_SIDE - 1) / NOISE_ESTIMATION_MAX_SIDE;
+        cv::resize(gray, gray, cv::Size(std::max(1, gray.cols / factor), std::max(1, gray.rows / factor)), 0, 0,
+                   cv::INTER_NEAREST);
+    }
+
+    if (gray.cols < 3 || gray.rows < 3)
+    {
+        return 0.0;
+    }
+
+    // Difference of two Laplacians, cancels image structure up to second order
+    const cv::Mat mask = (cv::Mat_<float>(3, 3) << 1, -2, 1, -2, 4, -2, 1, -2, 1);
+    cv::Mat highPass;
+    cv::filter2D(gray, highPass, CV_16S, mask, cv::Point(-1, -1), 0, cv::BORDER_REPLICATE);
+
+    // Median of absolute response via histogram, values are in [0, 16 * 255]
+    std::vector<size_t> histogram(16 * 255 + 1, 0);
+    for (int y = 1; y < highPass.rows - 1; ++y)
+    {
+        const short* row = highPass.ptr<short>(y);
+        for (int x = 1; x < highPass.cols - 1; ++x)
+        {
+            ++histogram[std::abs(row[x])];
+        }
+    }
+
+    const size_t half = static_cast<size_t>(highPass.rows - 2) * (highPass.cols - 2) / 2;
+    size_t accumulated = 0;
+    size_t median = 0;
+    for (; median < histogram.size(); ++median)
+    {
+        accumulated += histogram[median];
+        if (accumulated > half)
+        {
+            break;
+        }
+    }
+
+    return median * MAD_TO_SIGMA / NOISE_MASK_NORM;
+}
+
+bool prl::denoiseAdaptive(const cv::Mat& inputImage, cv::Mat& outputImage, double noiseFloor, double strengthPerSigma)
+{
+    const double sigma = estimateNoiseLevel(inputImage);
+
+    if (sigma < noiseFloor)
+    {
+        ++skippedCount;
+        if (outputImage.data != inputImage.data)
+        {
+            inputImage.copyTo(outputImage);
+        }
+        return false;
+    }
+
+    const double strength = std::min(std::max(strengthPerSigma * sigma, ADAPTIVE_MIN_STRENGTH), ADAPTIVE_MAX_STRENGTH);
+    denoise(inputImage, outputImage, strength);
+
+    ++processedCount;
+    return true;
+}
+
+prl::DenoiseStatistics prl::denoiseStatistics()
+{
+    DenoiseStatistics statistics;
+    statistics.processedCount = processedCount.load();
+    statistics.skippedCount = skippedCount.load();
+    return statistics;
+}
+
+void prl::resetDenoiseStatistics()
+{
+    processedCount = 0;
+    skippedCount = 0;
+}
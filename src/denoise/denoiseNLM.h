@@ -27,9 +27,51 @@
 
 #include <opencv2/core/core.hpp>
 
+#include <cstddef>
+
 namespace prl
 {
+/*!
+ * \brief Non-local means denoising.
+ * \param[in] inputImage 8-bit gray or BGR image.
+ * \param[out] outputImage Output image.
+ * \param[in] strength Filter strength (h parameter of NLM).
+ */
 CV_EXPORTS void denoise(const cv::Mat& inputImage, cv::Mat& outputImage, double strength = 5.5);
+
+/*!
+ * \brief Estimate standard deviation of additive noise.
+ * \param[in] inputImage 8-bit gray or BGR image.
+ * \return Noise sigma in 8-bit intensity units.
+ * \details Median absolute deviation of Laplacian-like high-pass band (Immerkaer's mask) of
+ * subsampled gray image. Subsampling keeps noise level and makes estimation cost independent
+ * of image size.
+ */
+CV_EXPORTS double estimateNoiseLevel(const cv::Mat& inputImage);
+
+/*!
+ * \brief Non-local means denoising with strength driven by estimated noise level.
+ * \param[in] inputImage 8-bit gray or BGR image.
+ * \param[out] outputImage Output image, copy of input if denoising is skipped.
+ * \param[in] noiseFloor Images with noise sigma below this value are not denoised.
+ * \param[in] strengthPerSigma Ratio of NLM h parameter to noise sigma.
+ * \return true if image was denoised, false if it was skipped.
+ */
+CV_EXPORTS bool denoiseAdaptive(const cv::Mat& inputImage, cv::Mat& outputImage, double noiseFloor = 2.0,
+                                double strengthPerSigma = 1.0);
+
+/*!
+ * \brief Counters of denoiseAdaptive() calls since start or last reset.
+ */
+struct DenoiseStatistics
+{
+    size_t processedCount;
+    size_t skippedCount;
+};
+
+CV_EXPORTS DenoiseStatistics denoiseStatistics();
+
+CV_EXPORTS void resetDenoiseStatistics();
 }
 
 
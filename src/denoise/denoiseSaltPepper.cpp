@@ -24,13 +24,87 @@
 
 #include "denoiseSaltPepper.h"
 
+#include <vector>
+
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include "utils.h"
+
+/*!
+ * Paint small components of given color with the opposite color.
+ * \return Count of removed components.
+ */
+static int removeSmallComponents(cv::Mat& binaryImage, uchar color, int maxArea, int maxDiameter)
+{
+    cv::Mat mask = binaryImage == color;
+
+    cv::Mat labels, stats, centroids;
+    const int count = cv::connectedComponentsWithStats(mask, labels, stats, centroids, 8, CV_32S);
+
+    std::vector<uchar> isRemoved(count, 0);
+    int removedCount = 0;
+    for (int label = 1; label < count; ++label)
+    {
+        const int* componentStats = stats.ptr<int>(label);
+        if (componentStats[cv::CC_STAT_AREA] <= maxArea && componentStats[cv::CC_STAT_WIDTH] <= maxDiameter &&
+            componentStats[cv::CC_STAT_HEIGHT] <= maxDiameter)
+        {
+            isRemoved[label] = 1;
+            ++removedCount;
+        }
+    }
+
+    if (removedCount == 0)
+    {
+        return 0;
+    }
+
+    const uchar oppositeColor = static_cast<uchar>(255 - color);
+    for (int y = 0; y < binaryImage.rows; ++y)
+    {
+        const int* labelRow = labels.ptr<int>(y);
+        uchar* row = binaryImage.ptr<uchar>(y);
+        for (int x = 0; x < binaryImage.cols; ++x)
+        {
+            if (isRemoved[labelRow[x]])
+            {
+                row[x] = oppositeColor;
+            }
+        }
+    }
+
+    return removedCount;
+}
+
 void prl::denoiseSaltPepper(const cv::Mat& inputImage, cv::Mat& outputImage, int kernelSize, size_t times)
 {
-    outputImage = inputImage.clone();
-    for(size_t i = 0; i < times; ++i)
+    if (times == 0)
+    {
+        outputImage = inputImage.clone();
+        return;
+    }
+
+    if (prl::isBinary(inputImage))
+    {
+        // Median of kernelSize window removes specks smaller than half of the window
+        const int maxArea = kernelSize * kernelSize / 2;
+        const int maxDiameter = kernelSize - 1;
+
+        cv::Mat cleanedImage = inputImage.clone();
+        // Pepper first, so that holes of removed specks are not taken for salt
+        removeSmallComponents(cleanedImage, 0, maxArea, maxDiameter);
+        removeSmallComponents(cleanedImage, 255, maxArea, maxDiameter);
+        outputImage = cleanedImage;
+        return;
+    }
+
+    // Ping-pong between output and one scratch buffer, the last iteration writes to output
+    cv::Mat scratch;
+    cv::Mat source = inputImage;
+    for (size_t i = 0; i < times; ++i)
     {
-        cv::medianBlur(outputImage, outputImage, kernelSize);
+        cv::Mat& target = (times - 1 - i) % 2 == 0 ? outputImage : scratch;
+        cv::medianBlur(source, target, kernelSize);
+        source = target;
     }
-}
\ No newline at end of file
+}
@@ -35,7 +35,9 @@ namespace prl
  * \param[out] outputImage Output image.
  * \param[in] kernelSize Kernel size for median filter.
  * \param[in] times Filter running times.
- * \details Implementation uses medianFilter for denoising.
+ * \details Binary (0/255) images are cleaned by connected components: black and white components
+ * with area up to kernelSize^2 / 2 which fit into kernelSize x kernelSize box are flipped in a single
+ * pass, times is ignored. Other images are filtered with median filter times times.
  */
 CV_EXPORTS void denoiseSaltPepper(const cv::Mat& inputImage, cv::Mat& outputImage, int kernelSize, size_t times);
 }
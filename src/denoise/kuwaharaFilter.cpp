@@ -3,6 +3,13 @@
 
 #include <cmath>
 #include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -11,6 +18,7 @@
 
 static const double PI              = 3.14159265;
 static const double GAUSSIAN_SIGMA  = 4.0;
+static const double TENSOR_SIGMA    = 2.0;
 static const double ECCEN_TUNING    = 1.0;
 static const double SIGMA_R         = 3.0;
 static const double SIGMA_S         = 3.0;
@@ -19,44 +27,82 @@ static const int    SECTOR_N        = 8;
 
 
 
-// TODO: remove global variables
-int map_circle_width, local_circle_width;
-double ***div_circle;
-std::vector<cv::Mat> div_circle_weight;
+//! Maximal count of image channels handled by the filter
+static const int MAX_CHANNELS       = 4;
+//! Polynomial weights are defined for 8 sectors only
+static const int POLYNOMIAL_SECTOR_N = 8;
+//! Sector weights below this value are ignored
+static const float MIN_SECTOR_WEIGHT = 0.0000001f;
 
 
-// Prototypes
-cv::Mat anisotropic_kuwahara(const cv::Mat& src_img);
-cv::Mat computationKernel(const cv::Mat src_image, const cv::Mat& eigenVec_ori_cos,
-                          const cv::Mat& eigenVec_ori_sin, const cv::Mat& amo_anisotropy);
+//! Offset of a sample inside the filter circle
+struct KernelTap
+{
+    int dy;
+    int dx;
+};
+
+//! Sector weight kernels of the anisotropic Kuwahara filter
+struct SectorKernelBank
+{
+    int sectors;
+    //! Kernels are width x width, row-major, one after another
+    int width;
+    std::vector<float> weights;
+
+    //! Samples inside the circle which have non-zero weight in some sector
+    std::vector<KernelTap> taps;
+    //! Weights of all sectors for each tap, tap-major
+    std::vector<float> tapWeights;
+
+    const float* sector(int s) const
+    {
+        return &weights[static_cast<size_t>(s) * width * width];
+    }
+
+    const float* weightsOfTap(size_t tap) const
+    {
+        return &tapWeights[tap * sectors];
+    }
+};
 
 
-void div_circle_initialize()
+// Prototypes
+static void tensorComputation(const cv::Mat& src_img, cv::Mat& eigenVec_ori_cos, cv::Mat& eigenVec_ori_sin,
+                              cv::Mat& amo_anisotropy);
+static void anisotropic_kuwahara(const cv::Mat& src_img, const SectorKernelBank& kernels, cv::Mat& filtered_img);
+static void polynomialKernel(const cv::Mat& src_image, const cv::Mat& eigenVec_ori_cos,
+                             const cv::Mat& eigenVec_ori_sin, const cv::Mat& amo_anisotropy,
+                             const SectorKernelBank& kernels, cv::Mat& filtered_image);
+static void computationKernel(const cv::Mat& src_image, const cv::Mat& eigenVec_ori_cos,
+                              const cv::Mat& eigenVec_ori_sin, const cv::Mat& amo_anisotropy,
+                              const SectorKernelBank& kernels, cv::Mat& filtered_image);
+
+
+static SectorKernelBank buildSectorKernels(int sectors, double sigmaR, double sigmaS)
 {
+    const int map_circle_width = (int) (2 * std::ceil(2 * sigmaR) + 1);
 
     double map_angle = 0.0, w_min = 0.0, w_max = 0.0;
 
-    cv::Mat gau_kernel = getGaussianKernel2D(map_circle_width, SIGMA_R);
+    cv::Mat gau_kernel = getGaussianKernel2D(map_circle_width, sigmaR);
     cv::Mat div_rotate;
     cv::Point2d map_centroid;
 
-    int c_i = 0, c_j = 0, map_i = 0, map_j = 0;
+    int map_i = 0, map_j = 0;
 
-
-    div_circle = new double** [SECTOR_N];
-    for (int s = 0; s < SECTOR_N; s++)
+    std::vector<cv::Mat> div_circle_weight(sectors);
+    for (int s = 0; s < sectors; s++)
     {
-        div_circle_weight[s].create(map_circle_width, map_circle_width, CV_64FC1);
-        div_circle_weight[s].setTo(0);
-
-        div_circle[s] = new double* [map_circle_width];
-        for (int c_i = 0; c_i < map_circle_width; c_i++)
-        {
-            div_circle[s][c_i] = new double[map_circle_width];
-        }
+        div_circle_weight[s] = cv::Mat::zeros(map_circle_width, map_circle_width, CV_64FC1);
     }
 
-    for (int s = 0; s < SECTOR_N; s++)
+    SectorKernelBank bank;
+    bank.sectors = sectors;
+    bank.width = map_circle_width;
+    bank.weights.resize(static_cast<size_t>(sectors) * map_circle_width * map_circle_width);
+
+    for (int s = 0; s < sectors; s++)
     {
         if (s <= 1)
         {
@@ -71,7 +117,7 @@ void div_circle_initialize()
                     {
                         map_angle = atan2(map_i, map_j);
 
-                        if (map_angle >= (2.0 * s - 1) * PI / SECTOR_N && map_angle <= (2.0 * s + 1) * PI / SECTOR_N)
+                        if (map_angle >= (2.0 * s - 1) * PI / sectors && map_angle <= (2.0 * s + 1) * PI / sectors)
                         {
                             div_circle_weight[s].at<double>(c_i, c_j) = 1.0;
                         }
@@ -80,7 +126,7 @@ void div_circle_initialize()
 
                 }
             }
-            cv::GaussianBlur(div_circle_weight[s], div_circle_weight[s], cv::Size(13, 13), SIGMA_S);
+            cv::GaussianBlur(div_circle_weight[s], div_circle_weight[s], cv::Size(13, 13), sigmaS);
 
             // multiply per element
             cv::multiply(div_circle_weight[s], gau_kernel, div_circle_weight[s]);
@@ -99,304 +145,556 @@ void div_circle_initialize()
 
             if (s % 2 == 0)
             {
-                div_rotate = cv::getRotationMatrix2D(map_centroid, s * (-360.0 / SECTOR_N), 1.0);
+                div_rotate = cv::getRotationMatrix2D(map_centroid, s * (-360.0 / sectors), 1.0);
                 cv::warpAffine(div_circle_weight[0], div_circle_weight[s], div_rotate, div_circle_weight[s].size());
             }
 
             else
             {
-                div_rotate = cv::getRotationMatrix2D(map_centroid, (s - 1) * (-360.0 / SECTOR_N), 1.0);
+                div_rotate = cv::getRotationMatrix2D(map_centroid, (s - 1) * (-360.0 / sectors), 1.0);
                 cv::warpAffine(div_circle_weight[1], div_circle_weight[s], div_rotate, div_circle_weight[s].size());
             }
         }
 
-        for (int c_i = 0; c_i < map_circle_width; c_i++)
+        cv::Mat sectorWeights(map_circle_width, map_circle_width, CV_32FC1,
+                              &bank.weights[static_cast<size_t>(s) * map_circle_width * map_circle_width]);
+        div_circle_weight[s].convertTo(sectorWeights, CV_32F);
+    }
+
+    // Sparse layout for the filtering loop
+    const int half_width = map_circle_width / 2;
+    for (int c_i = 0; c_i < map_circle_width; c_i++)
+    {
+        for (int c_j = 0; c_j < map_circle_width; c_j++)
         {
-            for (int c_j = 0; c_j < map_circle_width; c_j++)
+            const int tap_i = c_i - half_width;
+            const int tap_j = c_j - half_width;
+            if (tap_i * tap_i + tap_j * tap_j > half_width * half_width)
+            {
+                continue;
+            }
+
+            std::vector<float> tap_weights(sectors);
+            bool is_used = false;
+            for (int s = 0; s < sectors; s++)
+            {
+                const float weight = bank.sector(s)[c_i * map_circle_width + c_j];
+                if (weight >= MIN_SECTOR_WEIGHT && weight <= 1.0f)
+                {
+                    tap_weights[s] = weight;
+                    is_used = true;
+                }
+            }
+
+            if (is_used)
             {
-                div_circle[s][c_i][c_j] = div_circle_weight[s].at<double>(c_i, c_j);
+                bank.taps.push_back({tap_i, tap_j});
+                bank.tapWeights.insert(bank.tapWeights.end(), tap_weights.begin(), tap_weights.end());
             }
         }
     }
 
-    gau_kernel.release();
-    div_rotate.release();
-    map_centroid.~Point_();
+    return bank;
 }
 
+/*!
+ * Sector kernels depend only on filter parameters, so they are built once per parameter set
+ * and shared by all calls. Banks are never modified after construction.
+ */
+static std::shared_ptr<const SectorKernelBank> sectorKernels(int sectors, double sigmaR, double sigmaS)
+{
+    static std::mutex banksMutex;
+    static std::map<std::tuple<int, double, double>, std::shared_ptr<const SectorKernelBank>> banks;
+
+    std::lock_guard<std::mutex> lock(banksMutex);
 
+    std::shared_ptr<const SectorKernelBank>& bank = banks[std::make_tuple(sectors, sigmaR, sigmaS)];
+    if (!bank)
+    {
+        bank = std::make_shared<const SectorKernelBank>(buildSectorKernels(sectors, sigmaR, sigmaS));
+    }
 
-/*kuwaharaFilter::kuwaharaFilter()
+    return bank;
+}
+
+/*!
+ * Polynomial sector weights by Kyprianidis on the disc of taps with given radius.
+ * Ellipse of every pixel is mapped onto this disc, so weights depend on the tap only. Gaussian
+ * falloff and normalization over sectors are folded into them.
+ */
+static SectorKernelBank buildPolynomialKernels(float radius)
 {
-    //map_circle_width = (int) (2 * ceil(2 * SIGMA_R) + 1);
-    //local_circle_width = (int) (2 * ceil(2 * SIGMA_R) + 1);
+    const int half_width = static_cast<int>(std::ceil(radius));
+    const int width = 2 * half_width + 1;
+
+    const float zeta = 2.0f / radius;
+    const float sin_zero_cross = std::sin(static_cast<float>(PI) / POLYNOMIAL_SECTOR_N);
+    const float eta = (zeta + std::cos(static_cast<float>(PI) / POLYNOMIAL_SECTOR_N)) /
+                      (sin_zero_cross * sin_zero_cross);
+    const float half_sqrt2 = static_cast<float>(std::sqrt(0.5));
+
+    SectorKernelBank bank;
+    bank.sectors = POLYNOMIAL_SECTOR_N;
+    bank.width = width;
+    bank.weights.assign(static_cast<size_t>(POLYNOMIAL_SECTOR_N) * width * width, 0.0f);
+
+    float w[POLYNOMIAL_SECTOR_N];
+    for (int tap_i = -half_width; tap_i <= half_width; tap_i++)
+    {
+        for (int tap_j = -half_width; tap_j <= half_width; tap_j++)
+        {
+            // Disc of taps is mapped to disc of radius 0.5
+            float vx = 0.5f * tap_j / radius;
+            float vy = 0.5f * tap_i / radius;
+            const float v_sq = vx * vx + vy * vy;
+            if (v_sq > 0.25f)
+            {
+                continue;
+            }
 
-    div_circle_initialize();
-}*/
+            float vxx = zeta - eta * vx * vx;
+            float vyy = zeta - eta * vy * vy;
+            float z;
+            z = std::max(0.0f, vy + vxx);
+            w[0] = z * z;
+            z = std::max(0.0f, -vx + vyy);
+            w[2] = z * z;
+            z = std::max(0.0f, -vy + vxx);
+            w[4] = z * z;
+            z = std::max(0.0f, vx + vyy);
+            w[6] = z * z;
+
+            // Odd sectors are even ones rotated by 45 degrees
+            const float rx = half_sqrt2 * (vx - vy);
+            const float ry = half_sqrt2 * (vx + vy);
+            vx = rx;
+            vy = ry;
+            vxx = zeta - eta * vx * vx;
+            vyy = zeta - eta * vy * vy;
+            z = std::max(0.0f, vy + vxx);
+            w[1] = z * z;
+            z = std::max(0.0f, -vx + vyy);
+            w[3] = z * z;
+            z = std::max(0.0f, -vy + vxx);
+            w[5] = z * z;
+            z = std::max(0.0f, vx + vyy);
+            w[7] = z * z;
+
+            float sum = 0.0f;
+            for (int s = 0; s < POLYNOMIAL_SECTOR_N; s++)
+            {
+                sum += w[s];
+            }
 
+            if (sum <= 0.0f)
+            {
+                continue;
+            }
 
-void prl::denoiseKuwahara(const cv::Mat& inputImage, cv::Mat& outputImage, size_t iterations)
-{
-    //Init
+            const float g = std::exp(-3.125f * v_sq) / sum;
+            const size_t position = static_cast<size_t>(tap_i + half_width) * width + tap_j + half_width;
+            for (int s = 0; s < POLYNOMIAL_SECTOR_N; s++)
+            {
+                w[s] *= g;
+                bank.weights[static_cast<size_t>(s) * width * width + position] = w[s];
+            }
 
-    map_circle_width = (int) (2 * std::ceil(2 * SIGMA_R) + 1);
-    local_circle_width = (int) (2 * std::ceil(2 * SIGMA_R) + 1);
+            bank.taps.push_back({tap_i, tap_j});
+            bank.tapWeights.insert(bank.tapWeights.end(), w, w + POLYNOMIAL_SECTOR_N);
+        }
+    }
 
-    div_circle_initialize();
+    return bank;
+}
 
+static const SectorKernelBank& polynomialKernels()
+{
+    // Filter parameters are fixed, so the bank is built once
+    static const SectorKernelBank bank = buildPolynomialKernels(static_cast<float>(2.0 * SIGMA_R));
+    return bank;
+}
 
 
 
-    cv::Mat src_img = inputImage.clone();
+void prl::denoiseKuwahara(const cv::Mat& inputImage, cv::Mat& outputImage, size_t iterations, KuwaharaMode mode)
+{
+    CV_Assert(!inputImage.empty() && inputImage.channels() <= MAX_CHANNELS);
 
-    if (src_img.type() != CV_64FC3)
+    std::shared_ptr<const SectorKernelBank> kernels;
+    if (mode == KuwaharaMode::EXACT)
     {
-        src_img.convertTo(src_img, CV_64FC3);
-        src_img /= 255.0;
+        kernels = sectorKernels(SECTOR_N, SIGMA_R, SIGMA_S);
     }
-    // TODO: WTF?
-    //resizeMat(src_img, 0.8);
 
-    cv::Mat filtered_img = src_img.clone().setTo(0);
+    // Filter works on float image in [0, 1] range
+    double scale = 1.0;
+    switch (inputImage.depth())
+    {
+        case CV_8U:
+            scale = 1.0 / 255.0;
+            break;
+        case CV_16U:
+            scale = 1.0 / 65535.0;
+            break;
+        case CV_32F:
+        case CV_64F:
+            break;
+        default:
+            throw std::invalid_argument("Kuwahara filter supports only 8-bit, 16-bit unsigned and floating point images");
+    }
 
-    cv::Mat src_clone = src_img.clone();
+    cv::Mat src_img, filtered_img;
+    inputImage.convertTo(src_img, CV_32F, scale);
 
     for (size_t i = 0; i < iterations; ++i)
     {
-        filtered_img = anisotropic_kuwahara(src_clone);
-
-        src_clone = filtered_img.clone();
+        if (mode == KuwaharaMode::EXACT)
+        {
+            anisotropic_kuwahara(src_img, *kernels, filtered_img);
+        }
+        else
+        {
+            cv::Mat eigenVec_ori_cos, eigenVec_ori_sin, amo_anisotropy;
+            tensorComputation(src_img, eigenVec_ori_cos, eigenVec_ori_sin, amo_anisotropy);
+            polynomialKernel(src_img, eigenVec_ori_cos, eigenVec_ori_sin, amo_anisotropy, polynomialKernels(),
+                             filtered_img);
+        }
+        std::swap(src_img, filtered_img);
     }
 
-    outputImage = filtered_img;
+    src_img.convertTo(outputImage, inputImage.depth(), 1.0 / scale);
 }
 
-void tensorComputation(const cv::Mat& src_img, cv::Mat& eigenVec_ori_cos, cv::Mat& eigenVec_ori_sin,
-                       cv::Mat& amo_anisotropy)
+/*!
+ * Orientation and anisotropy of local structure.
+ * Structure tensor (E F; F G) is accumulated over channels, smoothed with separable Gaussian
+ * and decomposed in closed form, so everything is done on float planes row by row.
+ */
+static void tensorComputation(const cv::Mat& src_img, cv::Mat& eigenVec_ori_cos, cv::Mat& eigenVec_ori_sin,
+                              cv::Mat& amo_anisotropy)
 {
-    cv::Mat src_gau = src_img.clone().setTo(0);
+    cv::Mat src_gau;
     cv::GaussianBlur(src_img, src_gau, cv::Size(3, 3), GAUSSIAN_SIGMA);
-
-    cv::Mat src_dx_split[3], src_dy_split[3], src_gau_split[3];
-    cv::split(src_gau, src_gau_split);
-
-    for (size_t i = 0; i < 3; i++)
+    if (src_gau.depth() != CV_32F)
     {
-        src_dx_split[i] = cv::Mat(src_img.rows, src_img.cols, CV_64FC1).setTo(0);
-        src_dy_split[i] = cv::Mat(src_img.rows, src_img.cols, CV_64FC1).setTo(0);
-
-        cv::Sobel(src_gau_split[i], src_dx_split[i], CV_64FC1, 1, 0, 1);
-        cv::Sobel(src_gau_split[i], src_dy_split[i], CV_64FC1, 0, 1, 1);
+        src_gau.convertTo(src_gau, CV_32F);
     }
 
-    cv::Mat src_dx = src_img.clone().setTo(0), src_dy = src_img.clone().setTo(0);
-
-    cv::merge(src_dx_split, 3, src_dx);
-    cv::merge(src_dy_split, 3, src_dy);
+    cv::Mat src_dx, src_dy;
+    cv::Sobel(src_gau, src_dx, CV_32F, 1, 0, 1);
+    cv::Sobel(src_gau, src_dy, CV_32F, 0, 1, 1);
 
-    cv::Mat struct_tensor, eigen_val, eigen_vec;
+    const int channels = src_img.channels();
+    const int width = src_img.cols;
 
-    double lambda_one = 0.0, lambda_two = 0.0;
+    cv::Mat tensor_E(src_img.size(), CV_32FC1), tensor_F(src_img.size(), CV_32FC1), tensor_G(src_img.size(), CV_32FC1);
 
-    eigen_val.create(2, 1, CV_64FC1);
-    eigen_vec.create(2, 1, CV_64FC1);
-
-    for (size_t i = 0; i < src_img.rows; i++)
+    cv::parallel_for_(cv::Range(0, src_img.rows), [&](const cv::Range& range)
     {
-        for (size_t j = 0; j < src_img.cols; j++)
+        for (int i = range.start; i < range.end; i++)
         {
-            struct_tensor = cv::Mat(2, 2, CV_64FC1).setTo(0);
-
-            cv::Vec3d dx_temp = src_dx.at<cv::Vec3d>(i, j), dy_temp = src_dy.at<cv::Vec3d>(i, j);
+            const float* dx = src_dx.ptr<float>(i);
+            const float* dy = src_dy.ptr<float>(i);
+            float* e = tensor_E.ptr<float>(i);
+            float* f = tensor_F.ptr<float>(i);
+            float* g = tensor_G.ptr<float>(i);
 
-            for (size_t k = 0; k < 3; k++)
+            for (int j = 0; j < width; j++)
             {
-                struct_tensor.at<double>(0, 0) += std::pow(dx_temp[k], 2.0);
-                struct_tensor.at<double>(1, 0) += dx_temp[k] * dy_temp[k];
-                struct_tensor.at<double>(0, 1) += dx_temp[k] * dy_temp[k];
-                struct_tensor.at<double>(1, 1) += std::pow(dy_temp[k], 2.0);
-            }
-
+                float sum_e = 0.0f, sum_f = 0.0f, sum_g = 0.0f;
+                for (int k = 0; k < channels; k++)
+                {
+                    const float dx_temp = dx[j * channels + k], dy_temp = dy[j * channels + k];
+                    sum_e += dx_temp * dx_temp;
+                    sum_f += dx_temp * dy_temp;
+                    sum_g += dy_temp * dy_temp;
+                }
 
-            cv::eigen(struct_tensor, eigen_val, eigen_vec);
+                e[j] = sum_e;
+                f[j] = sum_f;
+                g[j] = sum_g;
+            }
+        }
+    });
 
-            lambda_one = ((double*) eigen_val.data)[0];
-            lambda_two = ((double*) eigen_val.data + 1)[0];
+    cv::GaussianBlur(tensor_E, tensor_E, cv::Size(0, 0), TENSOR_SIGMA);
+    cv::GaussianBlur(tensor_F, tensor_F, cv::Size(0, 0), TENSOR_SIGMA);
+    cv::GaussianBlur(tensor_G, tensor_G, cv::Size(0, 0), TENSOR_SIGMA);
 
-            double eigenVec_ori = atan2(lambda_one - struct_tensor.at<double>(0, 0),
-                                        (-1) * struct_tensor.at<double>(1, 0));
+    eigenVec_ori_cos.create(src_img.size(), CV_32FC1);
+    eigenVec_ori_sin.create(src_img.size(), CV_32FC1);
+    amo_anisotropy.create(src_img.size(), CV_32FC1);
 
-            eigenVec_ori_cos.at<double>(i, j) = cos(eigenVec_ori);
-            eigenVec_ori_sin.at<double>(i, j) = sin(eigenVec_ori);
-            amo_anisotropy.at<double>(i, j) = (lambda_one - lambda_two) / (lambda_one + lambda_two);
+    cv::parallel_for_(cv::Range(0, src_img.rows), [&](const cv::Range& range)
+    {
+        for (int i = range.start; i < range.end; i++)
+        {
+            const float* e = tensor_E.ptr<float>(i);
+            const float* f = tensor_F.ptr<float>(i);
+            const float* g = tensor_G.ptr<float>(i);
+            float* ori_cos = eigenVec_ori_cos.ptr<float>(i);
+            float* ori_sin = eigenVec_ori_sin.ptr<float>(i);
+            float* anisotropy = amo_anisotropy.ptr<float>(i);
+
+            // Branch-free, so that compiler vectorizes the loop
+            for (int j = 0; j < width; j++)
+            {
+                const float half_trace = 0.5f * (e[j] + g[j]);
+                const float half_diff = 0.5f * (e[j] - g[j]);
+                const float root = std::sqrt(half_diff * half_diff + f[j] * f[j]);
+                const float lambda_one = half_trace + root;
+                const float lambda_two = half_trace - root;
+
+                // Eigenvector of lambda_one is (lambda_one - E, -F) rotated, see atan2 in the reference
+                const float vec_x = -f[j];
+                const float vec_y = lambda_one - e[j];
+                const float vec_norm = std::sqrt(vec_x * vec_x + vec_y * vec_y);
+                const bool is_degenerate = vec_norm <= 0.0f;
+                const float inv_norm = 1.0f / (is_degenerate ? 1.0f : vec_norm);
+
+                ori_cos[j] = is_degenerate ? 1.0f : vec_x * inv_norm;
+                ori_sin[j] = is_degenerate ? 0.0f : vec_y * inv_norm;
+
+                const float lambda_sum = lambda_one + lambda_two;
+                anisotropy[j] = lambda_sum > 0.0f ? (lambda_one - lambda_two) / lambda_sum : 0.0f;
+            }
         }
-    }
+    });
 }
 
 
-cv::Mat anisotropic_kuwahara(const cv::Mat& src_img)
+static void anisotropic_kuwahara(const cv::Mat& src_img, const SectorKernelBank& kernels, cv::Mat& filtered_img)
 {
-    cv::Mat eigenVec_ori_cos = cv::Mat(src_img.rows, src_img.cols, CV_64FC1).setTo(0);
-    cv::Mat eigenVec_ori_sin = cv::Mat(src_img.rows, src_img.cols, CV_64FC1).setTo(0);
-    cv::Mat amo_anisotropy = cv::Mat(src_img.rows, src_img.cols, CV_64FC1).setTo(0);
+    cv::Mat eigenVec_ori_cos, eigenVec_ori_sin, amo_anisotropy;
 
     tensorComputation(src_img, eigenVec_ori_cos, eigenVec_ori_sin, amo_anisotropy);
 
-    cv::Mat src_split[3], filtered_split[3];
-    cv::Mat filtered_img = src_img.clone().setTo(0);
+    computationKernel(src_img, eigenVec_ori_cos, eigenVec_ori_sin, amo_anisotropy, kernels, filtered_img);
+}
 
-    cv::split(src_img, src_split);
 
-    //#pragma omp parallel for
-    for (size_t i = 0; i < 3; i++)
-    {
-        filtered_split[i] = computationKernel(src_split[i], eigenVec_ori_cos, eigenVec_ori_sin, amo_anisotropy);
-    }
+/*!
+ * Filter all channels of CV_32F image at once.
+ * For every pixel the circle of taps is mapped to the ellipse given by local orientation and anisotropy,
+ * weighted mean and variance are accumulated per sector, and each channel takes the mean of its
+ * least varying sector.
+ */
+static void computationKernel(const cv::Mat& src_image, const cv::Mat& eigenVec_ori_cos,
+                              const cv::Mat& eigenVec_ori_sin, const cv::Mat& amo_anisotropy,
+                              const SectorKernelBank& kernels, cv::Mat& filtered_image)
+{
+    CV_Assert(src_image.depth() == CV_32F);
 
-    cv::merge(filtered_split, 3, filtered_img);
+    const int channels = src_image.channels();
+    const int sectors = kernels.sectors;
+    const int rows = src_image.rows;
+    const int cols = src_image.cols;
+    const size_t tap_count = kernels.taps.size();
 
-    return filtered_img;
-}
+    filtered_image.create(src_image.size(), src_image.type());
 
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range)
+    {
+        // Scratch of this stripe: weighted sums per sector and channel
+        std::vector<float> div_mean(sectors * channels), div_s(sectors * channels), normalize_k(sectors);
 
-cv::Mat computationKernel(const cv::Mat src_image, const cv::Mat& eigenVec_ori_cos,
-                          const cv::Mat& eigenVec_ori_sin, const cv::Mat& amo_anisotropy)
-{
-    cv::Mat filtered_image = src_image.clone().setTo(0);
+        for (int i = range.start; i < range.end; i++)
+        {
+            const float* ori_cos = eigenVec_ori_cos.ptr<float>(i);
+            const float* ori_sin = eigenVec_ori_sin.ptr<float>(i);
+            const float* anisotropy = amo_anisotropy.ptr<float>(i);
+            float* filtered = filtered_image.ptr<float>(i);
 
-    // temp use
-    double temp_i = 0, temp_j = 0, temp_A = 0.0, temp_B = 0.0, temp_C = 0.0, temp_D = 0.0, temp_cos = 0.0, temp_sin = 0.0, temp_adA = 0.0, temp_Ada = 0.0, temp_det = 0.0;
+            for (int j = 0; j < cols; j++)
+            {
+                const float temp_cos = ori_cos[j];
+                const float temp_sin = ori_sin[j];
+                const float temp_adA = ECCEN_TUNING / (ECCEN_TUNING + anisotropy[j]);
+                const float temp_Ada = (ECCEN_TUNING + anisotropy[j]) / ECCEN_TUNING;
 
-    int map_i = 0, map_j = 0, half_l_width = 0, half_m_width = 0;
-    double div_mean[8] = {0.0}, div_s[8] = {0.0}, weight_alpha[8] = {0.0},
-           normalize_k = 0.0, normalize_alpha = 0.0, eccen_S_A[2][2];
+                const float temp_A = temp_cos * temp_adA;
+                const float temp_B = -temp_sin * temp_Ada;
+                const float temp_C = temp_sin * temp_adA;
+                const float temp_D = temp_cos * temp_Ada;
 
-    double div_temp_data = 0.0, map_circle_data = 0.0, add_temp = 0.0, l_m_ratio = 0.0;
+                const float temp_det = 1.0f / (temp_A * temp_D - temp_B * temp_C);
 
-    cv::Point2d map_centroid(map_circle_width / 2, map_circle_width / 2);
+                const float eccen_S_A[2][2] = {{temp_D * temp_det, -temp_C * temp_det},
+                                               {-temp_B * temp_det, temp_A * temp_det}};
 
+                std::fill(div_mean.begin(), div_mean.end(), 0.0f);
+                std::fill(div_s.begin(), div_s.end(), 0.0f);
+                std::fill(normalize_k.begin(), normalize_k.end(), 0.00000001f);
 
-    half_m_width = map_circle_width / 2;
-    half_l_width = local_circle_width / 2;
+                for (size_t t = 0; t < tap_count; t++)
+                {
+                    const KernelTap& tap = kernels.taps[t];
+
+                    // map eclipse shape local texture to circle
+                    const int map_i = i + cvRound(eccen_S_A[0][0] * tap.dy + eccen_S_A[0][1] * tap.dx);
+                    const int map_j = j + cvRound(eccen_S_A[1][0] * tap.dy + eccen_S_A[1][1] * tap.dx);
+                    if (map_i < 0 || map_i >= rows || map_j < 0 || map_j >= cols)
+                    {
+                        continue;
+                    }
 
-    l_m_ratio = (double) local_circle_width / map_circle_width;
+                    const float* pixel = src_image.ptr<float>(map_i) + map_j * channels;
+                    const float* weights = kernels.weightsOfTap(t);
 
-    double** m_circle, ** l_circle;
-    m_circle = new double* [map_circle_width];
-    l_circle = new double* [local_circle_width];
+                    for (int s = 0; s < sectors; s++)
+                    {
+                        const float weight = weights[s];
+                        if (weight == 0.0f)
+                        {
+                            continue;
+                        }
 
+                        normalize_k[s] += weight;
+                        for (int c = 0; c < channels; c++)
+                        {
+                            const float value = pixel[c];
+                            div_mean[s * channels + c] += weight * value;
+                            div_s[s * channels + c] += weight * value * value;
+                        }
+                    }
+                }
 
-    for (int i = 0; i < map_circle_width; i++)
-    {
-        m_circle[i] = new double[map_circle_width];
+                for (int c = 0; c < channels; c++)
+                {
+                    float min_variance = INFINITY;
+                    float best_mean = 0.0f;
+                    for (int s = 0; s < sectors; s++)
+                    {
+                        const float mean = div_mean[s * channels + c] / normalize_k[s];
+                        const float variance = div_s[s * channels + c] / normalize_k[s] - mean * mean;
+                        if (variance < min_variance)
+                        {
+                            min_variance = variance;
+                            best_mean = mean;
+                        }
+                    }
 
-        if (i < local_circle_width)
-        {
-            l_circle[i] = new double[local_circle_width];
+                    filtered[j * channels + c] = std::max(std::min(best_mean, 1.0f), 0.0f);
+                }
+            }
         }
-    }
+    });
+}
 
 
-    for (int i = 1; i < src_image.rows - 1; i++)
+/*!
+ * Anisotropic Kuwahara filter with polynomial weights, see
+ * J. E. Kyprianidis, A. Semmo, H. Kang, J. Doellner, "Anisotropic Kuwahara Filtering with Polynomial
+ * Weighting Functions", 2010.
+ * Like in computationKernel, precomputed disc of taps is mapped to the ellipse of every pixel. Sector
+ * results are blended with weights depending on their variance.
+ */
+static void polynomialKernel(const cv::Mat& src_image, const cv::Mat& eigenVec_ori_cos,
+                             const cv::Mat& eigenVec_ori_sin, const cv::Mat& amo_anisotropy,
+                             const SectorKernelBank& kernels, cv::Mat& filtered_image)
+{
+    CV_Assert(src_image.depth() == CV_32F && kernels.sectors == POLYNOMIAL_SECTOR_N);
+
+    const int channels = src_image.channels();
+    const int rows = src_image.rows;
+    const int cols = src_image.cols;
+    const size_t tap_count = kernels.taps.size();
+
+    const float alpha = static_cast<float>(ECCEN_TUNING);
+    const float half_q = static_cast<float>(SHARPNESS_Q / 2.0);
+
+    filtered_image.create(src_image.size(), src_image.type());
+
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range)
     {
-        for (int j = 1; j < src_image.cols - 1; j++)
+        float div_mean[POLYNOMIAL_SECTOR_N][MAX_CHANNELS];
+        float div_s[POLYNOMIAL_SECTOR_N][MAX_CHANNELS];
+        float normalize_k[POLYNOMIAL_SECTOR_N];
+
+        for (int i = range.start; i < range.end; i++)
         {
-            temp_cos = eigenVec_ori_cos.at<double>(i, j);
-            temp_sin = eigenVec_ori_sin.at<double>(i, j);
-            temp_adA = (ECCEN_TUNING) / (ECCEN_TUNING + amo_anisotropy.at<double>(i, j));
-            temp_Ada = (ECCEN_TUNING + amo_anisotropy.at<double>(i, j)) / (ECCEN_TUNING);
+            const float* ori_cos = eigenVec_ori_cos.ptr<float>(i);
+            const float* ori_sin = eigenVec_ori_sin.ptr<float>(i);
+            const float* anisotropy = amo_anisotropy.ptr<float>(i);
+            float* filtered = filtered_image.ptr<float>(i);
 
-            temp_A = temp_cos * temp_adA;
-            temp_B = (-1) * temp_sin * temp_Ada;
-            temp_C = temp_sin * temp_adA;
-            temp_D = temp_cos * temp_Ada;
+            for (int j = 0; j < cols; j++)
+            {
+                // Stored orientation is measured from y axis, ellipse is oriented along x axis
+                const float cos_phi = ori_sin[j];
+                const float sin_phi = ori_cos[j];
 
-            temp_det = 1.0 / (temp_A * temp_D - temp_B * temp_C);
+                // Ellipse axes relative to radius of the disc of taps
+                const float scale_a = std::min(std::max((alpha + anisotropy[j]) / alpha, 0.1f), 2.0f);
+                const float scale_b = std::min(std::max(alpha / (alpha + anisotropy[j]), 0.1f), 2.0f);
 
-            eccen_S_A[0][0] = temp_D * temp_det;
-            eccen_S_A[1][0] = (-1) * temp_B * temp_det;
-            eccen_S_A[0][1] = (-1) * temp_C * temp_det;
-            eccen_S_A[1][1] = temp_A * temp_det;
+                // (x, y) = R^T * diag(a, b) * tap, inverse of mapping the ellipse to the disc
+                const float map_xx = cos_phi * scale_a, map_xy = -sin_phi * scale_b;
+                const float map_yx = sin_phi * scale_a, map_yy = cos_phi * scale_b;
 
+                std::fill(&div_mean[0][0], &div_mean[0][0] + POLYNOMIAL_SECTOR_N * MAX_CHANNELS, 0.0f);
+                std::fill(&div_s[0][0], &div_s[0][0] + POLYNOMIAL_SECTOR_N * MAX_CHANNELS, 0.0f);
+                std::fill(normalize_k, normalize_k + POLYNOMIAL_SECTOR_N, 0.0f);
 
-            for (int c_i = 0; c_i < map_circle_width; c_i++)
-            {
-                for (int c_j = 0; c_j < map_circle_width; c_j++)
+                for (size_t t = 0; t < tap_count; t++)
                 {
-                    m_circle[c_i][c_j] = 0;
+                    const KernelTap& tap = kernels.taps[t];
 
-                    // temp_A = c_i upper, temp_B = c_j upper
-                    temp_i = (int) (l_m_ratio * c_i) - half_l_width;
-                    temp_j = (int) (l_m_ratio * c_j) - half_l_width;
+                    const int map_i = std::min(std::max(i + cvRound(map_yx * tap.dx + map_yy * tap.dy), 0), rows - 1);
+                    const int map_j = std::min(std::max(j + cvRound(map_xx * tap.dx + map_xy * tap.dy), 0), cols - 1);
 
+                    const float* pixel = src_image.ptr<float>(map_i) + map_j * channels;
+                    const float* weights = kernels.weightsOfTap(t);
 
-                    if (sqrt(temp_i * temp_i + temp_j * temp_j) <= half_l_width)
+                    for (int s = 0; s < POLYNOMIAL_SECTOR_N; s++)
                     {
-                        map_i = (int) eccen_S_A[0][0] * temp_i + eccen_S_A[0][1] * temp_j;
-                        map_j = (int) eccen_S_A[1][0] * temp_i + eccen_S_A[1][1] * temp_j;
-
-                        // map eclipse shape local texture to circle
-                        if (map_i + i >= 0 && map_i + i < src_image.rows && map_j + j >= 0 &&
-                            map_j + j < src_image.cols)
+                        const float weight = weights[s];
+                        if (weight == 0.0f)
                         {
-                            m_circle[c_i][c_j] = src_image.at<double>(map_i + i, map_j + j);
+                            continue;
                         }
 
+                        normalize_k[s] += weight;
+                        for (int c = 0; c < channels; c++)
+                        {
+                            const float value = pixel[c];
+                            div_mean[s][c] += weight * value;
+                            div_s[s][c] += weight * value * value;
+                        }
                     }
-
                 }
-            }
-
-            for (int s = 0; s < SECTOR_N; s++)
-            {
-                div_mean[s] = 0.0;
-                div_s[s] = 0.0;
-                weight_alpha[s] = 0.0;
-                normalize_k = 0.00000001;
 
-                for (int c_i = 0; c_i <= map_circle_width - 1; c_i++)
+                float output[MAX_CHANNELS] = {0.0f};
+                float output_weight = 0.0f;
+                for (int s = 0; s < POLYNOMIAL_SECTOR_N; s++)
                 {
-                    for (int c_j = 0; c_j <= map_circle_width - 1; c_j++)
+                    if (normalize_k[s] <= 0.0f)
                     {
-                        div_temp_data = div_circle[s][c_i][c_j];
-                        map_circle_data = m_circle[c_i][c_j];
-
-                        if (map_circle_data <= 1 && map_circle_data >= 0.0000001
-                            && div_temp_data <= 1 && div_temp_data >= 0.0000001)
-                        {
-                            div_mean[s] += map_circle_data * div_temp_data;
-                            div_s[s] += map_circle_data * map_circle_data * div_temp_data;
-                            normalize_k += div_temp_data;
-                        }
+                        continue;
                     }
-                }
 
-                div_mean[s] = div_mean[s] / normalize_k;
-                div_s[s] = std::sqrt(div_s[s] / normalize_k - div_mean[s] * div_mean[s]);
-            }
+                    float sigma_sq = 0.0f;
+                    for (int c = 0; c < channels; c++)
+                    {
+                        div_mean[s][c] /= normalize_k[s];
+                        sigma_sq += std::abs(div_s[s][c] / normalize_k[s] - div_mean[s][c] * div_mean[s][c]);
+                    }
 
+                    const float sector_weight = 1.0f / (1.0f + std::pow(255.0f * sigma_sq, half_q));
+                    output_weight += sector_weight;
+                    for (int c = 0; c < channels; c++)
+                    {
+                        output[c] += sector_weight * div_mean[s][c];
+                    }
+                }
 
-            size_t min_index = 0;
-            double min = INFINITY;
-            for (size_t s = 0; s < SECTOR_N; ++s)
-            {
-                if (min > div_s[s])
+                const float* source = src_image.ptr<float>(i) + j * channels;
+                for (int c = 0; c < channels; c++)
                 {
-                    min = div_s[s];
-                    min_index = s;
+                    const float value = output_weight > 0.0f ? output[c] / output_weight : source[c];
+                    filtered[j * channels + c] = std::max(std::min(value, 1.0f), 0.0f);
                 }
             }
-
-            filtered_image.at<double>(i, j) = std::max<double>(std::min<double>(div_mean[min_index], 1), 0);
         }
-    }
-
-    for (int i = 0; i < map_circle_width; i++)
-    {
-        delete[] m_circle[i];
-    }
-
-    delete[] m_circle;
-
-    return filtered_image;
+    });
 }
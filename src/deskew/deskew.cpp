@@ -46,6 +46,7 @@
 #endif //WIN32
 
 #include <algorithm>
+#include <cmath>
 #include <functional>
 #include <list>
 #include <map>
@@ -63,47 +64,195 @@
 
 #endif // !M_PI
 
+#include "debugSink.h"
 #include "formatConvert.h"
+#include "pixHandle.h"
 #include "rotate.h"
 #include "utils.h"
 
-double prl::findOrientation(const cv::Mat& inputImage)
+//! Upper bound of the long side of the mid level image (about 150 ppi for A4 page)
+static const int GEOMETRY_MID_LEVEL_MAX_SIDE = 1800;
+
+//! Coarse skew sweep step in degrees
+static const double SKEW_SWEEP_STEP = 1.0;
+
+//! Step (in degrees) at which halving search on the mid level image stops
+static const double SKEW_MIN_SEARCH_STEP = 0.01;
+
+//! Width of vertical strips (on the coarse level) whose foreground is shifted as a whole in
+//! projection profiles, position error is at most 0.7 pixel at 10 degrees. Mid level strips are
+//! twice wider, so the error relative to text size is the same.
+static const int SKEW_STRIP_WIDTH = 8;
+
+//! Skew angle (in degrees) below which deskewing is not done
+static const double DESKEW_MIN_ANGLE = 0.1;
+
+//! Skew confidence below which deskewing is not done. On rotated test_data/binarize pages all
+//! estimates within 0.3 degree but one have confidence above it, while a third of non-text
+//! images (test_data/denoise, test_data/blurred) fall below it.
+static const double DESKEW_MIN_CONFIDENCE = 5.0;
+
+//! Skew angle (in degrees) up to which binary pages are rotated by shears
+static const double DESKEW_MAX_SHEAR_ANGLE = 10.0;
+
+//! Reduce image by integer factor (fast area interpolation) until its long side fits maxSide
+static cv::Mat reduceToSide(const cv::Mat& image, int maxSide)
+{
+    const int longSide = std::max(image.cols, image.rows);
+    const int factor = (longSide + maxSide - 1) / maxSide;
+
+    if (factor <= 1)
+    {
+        return image;
+    }
+
+    cv::Mat reducedImage;
+    cv::resize(image, reducedImage,
+               cv::Size(image.cols / factor, image.rows / factor), 0, 0, cv::INTER_AREA);
+
+    return reducedImage;
+}
+
+//! Foreground pixels of one row of a vertical strip, x is the strip centre
+struct StripRow
+{
+    int x;
+    int y;
+    int count;
+};
+
+//! Count foreground (black) pixels of binary image by rows of vertical strips
+static void foregroundStrips(const cv::Mat& binaryImage, int stripWidth, std::vector<StripRow>& strips)
+{
+    strips.clear();
+    for (int y = 0; y < binaryImage.rows; ++y)
+    {
+        const uchar* row = binaryImage.ptr<uchar>(y);
+        for (int x0 = 0; x0 < binaryImage.cols; x0 += stripWidth)
+        {
+            const int x1 = std::min(x0 + stripWidth, binaryImage.cols);
+
+            int count = 0;
+            for (int x = x0; x < x1; ++x)
+            {
+                count += row[x] == 0;
+            }
+
+            if (count != 0)
+            {
+                strips.push_back({(x0 + x1 - 1) / 2, y, count});
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Score of horizontal projection profile of foreground strips sheared by angle.
+ * \details Sum of squared differences of neighbour profile bins, it is the largest
+ * when text lines are parallel to projection direction.
+ */
+static double projectionScore(const std::vector<StripRow>& strips, const cv::Size& size,
+                              double angle, std::vector<int>& profile)
+{
+    const double slope = std::tan(angle * CV_PI / 180.0);
+    const double xCenter = (size.width - 1) / 2.0;
+    const int margin = cvCeil(std::abs(slope) * xCenter) + 1;
+
+    profile.assign(size.height + 2 * margin, 0);
+    for (const StripRow& strip : strips)
+    {
+        profile[cvRound(strip.y - slope * (strip.x - xCenter)) + margin] += strip.count;
+    }
+
+    double score = 0.0;
+    for (size_t i = 1; i < profile.size(); ++i)
+    {
+        const double difference = profile[i] - profile[i - 1];
+        score += difference * difference;
+    }
+
+    return score;
+}
+
+//! Find angle with the best projection score in [from; to] range
+static double sweepSkew(const std::vector<StripRow>& strips, const cv::Size& size,
+                        double from, double to, double step,
+                        double& maxScore, double& minScore)
 {
-    cv::Mat grayImage;
-    if(inputImage.channels() == 3)
+    std::vector<int> profile;
+
+    double bestAngle = 0.0;
+    maxScore = -1.0;
+    minScore = -1.0;
+
+    for (double angle = from; angle <= to + step / 2.0; angle += step)
     {
-        cv::cvtColor(inputImage, grayImage, cv::COLOR_BGR2GRAY);
+        const double score = projectionScore(strips, size, angle, profile);
+        if (score > maxScore)
+        {
+            maxScore = score;
+            bestAngle = angle;
+        }
+        if (minScore < 0.0 || score < minScore)
+        {
+            minScore = score;
+        }
     }
 
-    cv::adaptiveThreshold(grayImage, grayImage, 255, cv::ADAPTIVE_THRESH_MEAN_C, cv::THRESH_BINARY, 19, 9);
+    return bestAngle;
+}
+
+//! Refine angle found by sweep with given step, the step is halved around the best angle
+//! (binary search of Leptonica pixFindSkewSweepAndSearch)
+static double searchSkew(const std::vector<StripRow>& strips, const cv::Size& size,
+                         double angle, double step)
+{
+    std::vector<int> profile;
 
-    PIX* pix = prl::opencvToLeptonica(&grayImage);
-    if (!pix)
+    double bestScore = projectionScore(strips, size, angle, profile);
+    for (step /= 2.0; step >= SKEW_MIN_SEARCH_STEP; step /= 2.0)
     {
-        return 0;
+        const double leftScore = projectionScore(strips, size, angle - step, profile);
+        const double rightScore = projectionScore(strips, size, angle + step, profile);
+
+        if (leftScore > bestScore && leftScore >= rightScore)
+        {
+            bestScore = leftScore;
+            angle -= step;
+        }
+        else if (rightScore > bestScore)
+        {
+            bestScore = rightScore;
+            angle += step;
+        }
     }
 
+    return angle;
+}
+
+//! Detect orientation of binary (0/255) image with Leptonica, angle for prl::rotate is returned
+static double detectOrientation(const cv::Mat& binaryImage, double& upConfidence, double& leftConfidence)
+{
+    upConfidence = 0.0;
+    leftConfidence = 0.0;
+
+    prl::PixHandle pix = prl::acquirePix(binaryImage.cols, binaryImage.rows, 1);
+    prl::opencvToLeptonicaBinary(binaryImage, pix.get());
+
     l_int32 iOrientation = 0;
     {
         l_float32 fUpConf;
         l_float32 fLeftConf;
-        if (pixOrientDetectDwa(pix, &fUpConf, &fLeftConf, 0, 0) != 0)
+        if (pixOrientDetectDwa(pix.get(), &fUpConf, &fLeftConf, 0, 0) != 0)
         {
-            if (pix)
-            {
-                pixDestroy(&pix);
-            }
-
             return 0;
         }
 
+        upConfidence = fUpConf;
+        leftConfidence = fLeftConf;
+
         if (makeOrientDecision(fUpConf, fLeftConf, 0.0, 0.0, &iOrientation, 0) != 0)
         {
-            if (pix)
-            {
-                pixDestroy(&pix);
-            }
-
             return 0;
         }
     }
@@ -130,11 +279,83 @@ double prl::findOrientation(const cv::Mat& inputImage)
         angle = 0.0;
     }
 
-    pixDestroy(&pix);
-
     return angle;
 }
 
+/*!
+ * \brief Compose skew correction and orientation turn into one affine transform.
+ * \param[in] imageSize Size of the transformed image.
+ * \param[in] skewAngle Skew angle in degrees (same convention as prl::rotate).
+ * \param[in] orientationAngle Right angle turn (0, 90, 180 or 270) applied after deskewing.
+ * \param[out] outputSize Size of the bounding box of the transformed image.
+ * \return 2x3 affine matrix for cv::warpAffine.
+ */
+static cv::Mat deskewTransform(const cv::Size& imageSize, double skewAngle, double orientationAngle,
+                               cv::Size& outputSize)
+{
+    const cv::Point2f center((imageSize.width - 1) / 2.0f, (imageSize.height - 1) / 2.0f);
+    cv::Mat skewTransform = cv::getRotationMatrix2D(center, skewAngle, 1.0);
+
+    //! Rotated bounding box instead of len x len square canvas
+    const double absCos = std::abs(skewTransform.at<double>(0, 0));
+    const double absSin = std::abs(skewTransform.at<double>(0, 1));
+    int width = cvRound(imageSize.height * absSin + imageSize.width * absCos);
+    int height = cvRound(imageSize.height * absCos + imageSize.width * absSin);
+
+    skewTransform.at<double>(0, 2) += (width - 1) / 2.0 - center.x;
+    skewTransform.at<double>(1, 2) += (height - 1) / 2.0 - center.y;
+
+    //! Clockwise right angle turns, the same as transpose/flip in prl::rotate
+    cv::Matx33d turn = cv::Matx33d::eye();
+    orientationAngle = std::fmod(orientationAngle, 360.0);
+    if (prl::eq_d(orientationAngle, 90.0))
+    {
+        turn = cv::Matx33d(0, -1, height - 1,
+                           1, 0, 0,
+                           0, 0, 1);
+        std::swap(width, height);
+    }
+    else if (prl::eq_d(orientationAngle, 180.0))
+    {
+        turn = cv::Matx33d(-1, 0, width - 1,
+                           0, -1, height - 1,
+                           0, 0, 1);
+    }
+    else if (prl::eq_d(orientationAngle, 270.0))
+    {
+        turn = cv::Matx33d(0, 1, 0,
+                           -1, 0, width - 1,
+                           0, 0, 1);
+        std::swap(width, height);
+    }
+
+    const cv::Matx33d skew(
+            skewTransform.at<double>(0, 0), skewTransform.at<double>(0, 1), skewTransform.at<double>(0, 2),
+            skewTransform.at<double>(1, 0), skewTransform.at<double>(1, 1), skewTransform.at<double>(1, 2),
+            0, 0, 1);
+    const cv::Matx33d composed = turn * skew;
+
+    outputSize = cv::Size(width, height);
+
+    return cv::Mat(cv::Matx23d(composed(0, 0), composed(0, 1), composed(0, 2),
+                               composed(1, 0), composed(1, 1), composed(1, 2)), true);
+}
+
+double prl::findOrientation(const cv::Mat& inputImage)
+{
+    cv::Mat grayImage = reduceToSide(inputImage, GEOMETRY_MID_LEVEL_MAX_SIDE);
+    if(grayImage.channels() == 3)
+    {
+        cv::cvtColor(grayImage, grayImage, cv::COLOR_BGR2GRAY);
+    }
+
+    cv::Mat binaryImage;
+    cv::adaptiveThreshold(grayImage, binaryImage, 255, cv::ADAPTIVE_THRESH_MEAN_C, cv::THRESH_BINARY, 19, 9);
+
+    double upConfidence, leftConfidence;
+    return detectOrientation(binaryImage, upConfidence, leftConfidence);
+}
+
 
 double prl::findAngle(const cv::Mat& inputImage)
 {
@@ -146,7 +367,6 @@ double prl::findAngle(const cv::Mat& inputImage)
     cv::bitwise_not(input, input);
     std::vector<cv::Vec4i> lines;
     cv::HoughLinesP(input, lines, 1, CV_PI / 180, 100, imgSize.width / 8.f, 20);
-    cv::Mat disp_lines(imgSize, CV_8UC1, cv::Scalar(0, 0, 0));
 
     const int nb_lines = static_cast<int>(lines.size());
     if (!nb_lines)
@@ -154,16 +374,20 @@ double prl::findAngle(const cv::Mat& inputImage)
         return 0.0;
     }
 
+    if (PRL_DEBUG_ENABLED())
+    {
+        cv::Mat disp_lines(imgSize, CV_8UC1, cv::Scalar(0, 0, 0));
+        for (const cv::Vec4i& line : lines)
+        {
+            cv::line(disp_lines, cv::Point(line[0], line[1]), cv::Point(line[2], line[3]), cv::Scalar(255, 0, 0));
+        }
+        prl::publishDebugImage("findAngle_lines", disp_lines);
+    }
+
     std::vector<double> cv_angles = std::vector<double>(nb_lines);
 
     for (int i = 0; i < nb_lines; ++i)
     {
-        cv::line(
-                disp_lines,
-                cv::Point(lines[i][0], lines[i][1]),
-                cv::Point(lines[i][2], lines[i][3]),
-                cv::Scalar(255, 0, 0));
-
         cv_angles[i] = atan2(
                 (double) lines[i][3] - lines[i][1],
                 (double) lines[i][2] - lines[i][0]);
@@ -205,41 +429,100 @@ double prl::findAngle(const cv::Mat& inputImage)
     return cv_angle;
 }
 
-CV_EXPORTS bool prl::deskew(const cv::Mat& inputImage, cv::Mat& outputImage)
+prl::PageGeometry prl::estimatePageGeometry(const cv::Mat& inputImage, double maxSkewAngle)
 {
     CV_Assert(!inputImage.empty());
 
-    cv::Mat processingImage;
+    PageGeometry geometry;
 
-    if (inputImage.channels() != 1)
-    {
-        cv::cvtColor(inputImage, processingImage, cv::COLOR_BGR2GRAY);
-    }
-    else
+    //! Mid level: skew refinement and orientation detection
+    cv::Mat midImage = reduceToSide(inputImage, GEOMETRY_MID_LEVEL_MAX_SIDE);
+    if (midImage.channels() != 1)
     {
-        processingImage = inputImage.clone();
+        cv::cvtColor(midImage, midImage, cv::COLOR_BGR2GRAY);
     }
 
-    //TODO: Should we use here another binarization algorithm?
-    cv::threshold(processingImage, processingImage, 128, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+    //! Coarse level: skew sweep, Otsu threshold is shared with the mid level
+    cv::Mat coarseImage, coarseBinary;
+    cv::resize(midImage, coarseImage,
+               cv::Size(std::max(1, midImage.cols / 2), std::max(1, midImage.rows / 2)), 0, 0, cv::INTER_AREA);
+    const double threshold = cv::threshold(coarseImage, coarseBinary, 128, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
 
-    double angle = findAngle(processingImage);
+    cv::Mat midBinary;
+    cv::threshold(midImage, midBinary, threshold, 255, cv::THRESH_BINARY);
 
-    if ((angle != 0) && (angle <= DBL_MAX && angle >= -DBL_MAX))
+    std::vector<StripRow> strips;
+    foregroundStrips(coarseBinary, SKEW_STRIP_WIDTH, strips);
+
+    if (!strips.empty())
     {
-        prl::rotate(inputImage, outputImage, angle);
-        prl::rotate(processingImage, processingImage, angle);
+        double maxScore, minScore;
+        const double coarseAngle = sweepSkew(strips, coarseBinary.size(), -maxSkewAngle, maxSkewAngle,
+                                             SKEW_SWEEP_STEP, maxScore, minScore);
+        geometry.skewConfidence = minScore > 0.0 ? maxScore / minScore : 0.0;
+
+        foregroundStrips(midBinary, 2 * SKEW_STRIP_WIDTH, strips);
+        const double skewAngle = searchSkew(strips, midBinary.size(), coarseAngle, SKEW_SWEEP_STEP);
+
+        //! Small or unreliable skew is not corrected
+        if (std::abs(skewAngle) >= DESKEW_MIN_ANGLE && geometry.skewConfidence >= DESKEW_MIN_CONFIDENCE)
+        {
+            geometry.skewAngle = skewAngle;
+        }
     }
-    else
+
+    //! Orientation is detected on the mid level image deskewed the same way as the page
+    if (geometry.skewAngle != 0.0)
     {
-        outputImage = inputImage.clone();
+        prl::rotate(midBinary, midBinary, geometry.skewAngle, prl::RotationMode::AUTO);
     }
 
-    angle = findOrientation(processingImage);
+    geometry.orientation = detectOrientation(midBinary, geometry.upConfidence, geometry.leftConfidence);
+
+    return geometry;
+}
+
+cv::Mat prl::pageGeometryTransform(const cv::Size& imageSize, const PageGeometry& geometry,
+                                   cv::Size& outputSize)
+{
+    return deskewTransform(imageSize, geometry.skewAngle, geometry.orientation, outputSize);
+}
+
+bool prl::deskew(const cv::Mat& inputImage, cv::Mat& outputImage)
+{
+    CV_Assert(!inputImage.empty());
+
+    //! Skew and orientation are estimated on reduced copies, full image is resampled only once
+    const PageGeometry geometry = estimatePageGeometry(inputImage);
+
+    const double skewAngle = geometry.skewAngle;
+    const double orientationAngle = geometry.orientation;
 
-    if (angle != 0.0)
+    if (skewAngle != 0.0 && prl::isBinary(inputImage) &&
+        std::abs(skewAngle) <= DESKEW_MAX_SHEAR_ANGLE)
+    {
+        //! Binary pages are rotated by shears, right angle turn is a transpose/flip
+        prl::rotate(inputImage, outputImage, skewAngle, prl::RotationMode::SHEAR);
+
+        if (orientationAngle != 0.0)
+        {
+            prl::rotate(outputImage, outputImage, orientationAngle);
+        }
+    }
+    else if (skewAngle != 0.0)
+    {
+        cv::Size outputSize;
+        cv::Mat transform = deskewTransform(inputImage.size(), skewAngle, orientationAngle, outputSize);
+        cv::warpAffine(inputImage, outputImage, transform, outputSize,
+                       cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar::all(255));
+    }
+    else if (orientationAngle != 0.0)
+    {
+        prl::rotate(inputImage, outputImage, orientationAngle);
+    }
+    else
     {
-        prl::rotate(outputImage, outputImage, angle);
+        outputImage = inputImage.clone();
     }
 
     if (outputImage.empty())
@@ -248,4 +531,4 @@ CV_EXPORTS bool prl::deskew(const cv::Mat& inputImage, cv::Mat& outputImage)
     }
 
     return true;
-}
\ No newline at end of file
+}
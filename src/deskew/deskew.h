@@ -35,6 +35,9 @@ namespace prl
  * @param inputImage Image for deskewing.
  * @param outputImage Deskewed image.
  * @return true if processing successful.
+ * @details Skew and orientation are estimated on a reduced copy of the image, then
+ * both corrections are applied to the full image with a single resampling.
+ * Output image has the size of the rotated bounding box.
  *
  * \note Implementation of this procedure is based on
  * <a href="http://www.leptonica.com/">Leptonica library</a>.
@@ -51,6 +54,44 @@ CV_EXPORTS bool deskew(const cv::Mat& inputImage, cv::Mat& outputImage);
  */
 CV_EXPORTS double findOrientation(const cv::Mat& inputImage);
 
+/**
+ * @brief Skew and orientation of a page.
+ */
+struct PageGeometry
+{
+    double skewAngle = 0.0;         //!< Skew angle in degrees, rotation by it straightens text lines.
+                                    //!< Zero when the skew is too small or its confidence is too low.
+    double skewConfidence = 0.0;    //!< Ratio of the best projection profile score to the worst one.
+    double orientation = 0.0;       //!< Clockwise right angle turn (0, 90, 180 or 270) after deskewing.
+    double upConfidence = 0.0;      //!< Leptonica confidence of up/down orientation.
+    double leftConfidence = 0.0;    //!< Leptonica confidence of left/right orientation.
+};
+
+/**
+ * @brief Estimate skew and orientation of a page without rotating it.
+ * @param inputImage Image of a document.
+ * @param maxSkewAngle Largest skew angle (in degrees) which is searched.
+ * @return Skew, orientation and their confidences.
+ * @details Skew is found by projection profiles sweep on a small pyramid level and
+ * refined by halving search on a mid level image. Orientation is detected on the mid level
+ * image rotated by the returned skew angle, so it matches the image deskew() turns.
+ * Full resolution image is only read once for reduction.
+ *
+ * \note Implementation of this procedure is based on
+ * <a href="http://www.leptonica.com/">Leptonica library</a>.
+ */
+CV_EXPORTS PageGeometry estimatePageGeometry(const cv::Mat& inputImage, double maxSkewAngle = 10.0);
+
+/**
+ * @brief Get affine transform which corrects page geometry.
+ * @param imageSize Size of an image.
+ * @param geometry Page geometry from estimatePageGeometry.
+ * @param outputSize Size of the corrected image (rotated bounding box).
+ * @return 2x3 matrix for cv::warpAffine or cv::transform of coordinates.
+ */
+CV_EXPORTS cv::Mat pageGeometryTransform(const cv::Size& imageSize, const PageGeometry& geometry,
+                                         cv::Size& outputSize);
+
 /**
  * @brief Find angle of an image.
  * @param inputImage Image for deskewing.
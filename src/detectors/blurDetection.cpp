@@ -24,67 +24,247 @@
 
 #include "blurDetection.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
 #include <opencv2/imgproc/imgproc.hpp>
 
-// https://stackoverflow.com/questions/7765810/is-there-a-way-to-detect-if-an-image-is-blurry
+//! Longer side of the page used for blur detection
+static const int FOCUS_MAX_SIDE = 1024;
 
-// OpenCV port of 'LAPM' algorithm (Nayar89)
-double LAPM_Algo(const cv::Mat& src)
+// Gray page with longer side of at most FOCUS_MAX_SIDE
+static cv::Mat reducedGray(const cv::Mat& inputImage)
 {
-    cv::Mat M = (cv::Mat_<double>(3, 1) << -1, 2, -1);
-    cv::Mat G = cv::getGaussianKernel(3, -1, CV_64F);
-
-    cv::Mat Lx;
-    cv::sepFilter2D(src, Lx, CV_64F, M, G);
-
-    cv::Mat Ly;
-    cv::sepFilter2D(src, Ly, CV_64F, G, M);
+    if (inputImage.empty())
+    {
+        throw std::invalid_argument("Input image for blur detection is empty");
+    }
 
-    cv::Mat FM = cv::abs(Lx) + cv::abs(Ly);
+    // Reduce color image first, so that only the small image is converted to gray
+    cv::Mat reduced = inputImage;
+    const int maxSide = std::max(inputImage.cols, inputImage.rows);
+    if (maxSide > FOCUS_MAX_SIDE)
+    {
+        const int factor = (maxSide + FOCUS_MAX_SIDE - 1) / FOCUS_MAX_SIDE;
+        cv::resize(inputImage, reduced, cv::Size(std::max(1, inputImage.cols / factor),
+                                                 std::max(1, inputImage.rows / factor)), 0, 0, cv::INTER_AREA);
+    }
 
-    double focusMeasure = cv::mean(FM).val[0];
-    return focusMeasure;
+    cv::Mat gray;
+    if (reduced.channels() == 1)
+    {
+        gray = reduced;
+    }
+    else
+    {
+        cv::cvtColor(reduced, gray, reduced.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+    }
+    return gray;
 }
 
-// OpenCV port of 'LAPV' algorithm (Pech2000)
-double LAPV_Algo(const cv::Mat& src)
+/*!
+ * Variance of 3x3 Laplacian (the kernel of cv::Laplacian with ksize = 1) over inner pixels,
+ * computed in one row-parallel pass with integer accumulators.
+ */
+static double laplacianVarianceGray(const cv::Mat& grayImage)
 {
-    cv::Mat lap;
-    cv::Laplacian(src, lap, CV_64F);
+    CV_Assert(grayImage.type() == CV_8UC1);
+
+    const int rows = grayImage.rows;
+    const int cols = grayImage.cols;
+    if (rows < 3 || cols < 3)
+    {
+        return 0.0;
+    }
+
+    // Per-row sums, reduced after the parallel pass
+    std::vector<int64_t> laplacianSums(rows, 0);
+    std::vector<int64_t> laplacianSquareSums(rows, 0);
+
+    cv::parallel_for_(cv::Range(1, rows - 1), [&](const cv::Range& range)
+    {
+        for (int y = range.start; y < range.end; ++y)
+        {
+            const uchar* up = grayImage.ptr<uchar>(y - 1);
+            const uchar* center = grayImage.ptr<uchar>(y);
+            const uchar* down = grayImage.ptr<uchar>(y + 1);
 
-    cv::Scalar mu, sigma;
-    cv::meanStdDev(lap, mu, sigma);
+            int64_t laplacianSum = 0;
+            int64_t laplacianSquareSum = 0;
+            for (int x = 1; x < cols - 1; ++x)
+            {
+                const int laplacian = up[x] + down[x] + center[x - 1] + center[x + 1] - 4 * center[x];
+                laplacianSum += laplacian;
+                laplacianSquareSum += laplacian * laplacian;
+            }
 
-    double focusMeasure = sigma.val[0] * sigma.val[0];
-    return focusMeasure;
+            laplacianSums[y] = laplacianSum;
+            laplacianSquareSums[y] = laplacianSquareSum;
+        }
+    });
+
+    int64_t laplacianSum = 0, laplacianSquareSum = 0;
+    for (int y = 1; y < rows - 1; ++y)
+    {
+        laplacianSum += laplacianSums[y];
+        laplacianSquareSum += laplacianSquareSums[y];
+    }
+
+    const double count = static_cast<double>(rows - 2) * (cols - 2);
+    const double laplacianMean = laplacianSum / count;
+    return laplacianSquareSum / count - laplacianMean * laplacianMean;
 }
 
-// OpenCV port of 'TENG' algorithm (Krotkov86)
-double TENG_Algo(const cv::Mat& src, const int ksize)
+double prl::laplacianVariance(const cv::Mat& inputImage)
 {
-    cv::Mat Gx, Gy;
-    cv::Sobel(src, Gx, CV_64F, 1, 0, ksize);
-    cv::Sobel(src, Gy, CV_64F, 0, 1, ksize);
+    cv::Mat gray;
+    if (inputImage.channels() == 1)
+    {
+        gray = inputImage;
+    }
+    else
+    {
+        cv::cvtColor(inputImage, gray, inputImage.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+    }
+
+    if (gray.depth() == CV_8U)
+    {
+        return laplacianVarianceGray(gray);
+    }
 
-    cv::Mat FM = Gx.mul(Gx) + Gy.mul(Gy);
+    // Other depths are rare (e.g. float deconvolution results), measure them in floating point
+    cv::Mat laplacian;
+    cv::Laplacian(gray, laplacian, CV_64F);
 
-    double focusMeasure = cv::mean(FM).val[0];
-    return focusMeasure;
+    cv::Scalar mean, deviation;
+    cv::meanStdDev(laplacian, mean, deviation);
+    return deviation[0] * deviation[0];
+}
+
+prl::BlurDetectionResult prl::detectBlur(const cv::Mat& inputImage, double threshold)
+{
+    BlurDetectionResult result;
+    result.score = laplacianVariance(reducedGray(inputImage));
+    result.isBlurred = result.score < threshold;
+    return result;
 }
 
-// OpenCV port of 'GLVN' algorithm (Santos97)
-double GLVN_Algo(const cv::Mat& src)
+prl::FocusMap prl::focusMap(const cv::Mat& inputImage, cv::Size gridSize, double threshold, double minContrast)
 {
-    cv::Scalar mu, sigma;
-    cv::meanStdDev(src, mu, sigma);
+    if (gridSize.width <= 0 || gridSize.height <= 0)
+    {
+        throw std::invalid_argument("Focus map grid size must be positive");
+    }
 
-    double focusMeasure = (sigma.val[0] * sigma.val[0]) / mu.val[0];
-    return focusMeasure;
+    const cv::Mat gray = reducedGray(inputImage);
+    const int rows = gray.rows;
+    const int cols = gray.cols;
+
+    FocusMap result;
+    result.sharpness = cv::Mat::zeros(gridSize, CV_32FC1);
+    result.contrast = cv::Mat::zeros(gridSize, CV_32FC1);
+    result.blurredFraction = 0.0;
+    if (rows < 3 || cols < 3)
+    {
+        return result;
+    }
+
+    // Tile bounds over inner pixels, every tile row is processed by one worker
+    auto tileStart = [](int tile, int tiles, int length)
+    {
+        return 1 + static_cast<int>(static_cast<int64_t>(tile) * (length - 2) / tiles);
+    };
+
+    cv::parallel_for_(cv::Range(0, gridSize.height), [&](const cv::Range& range)
+    {
+        std::vector<int64_t> intensitySums(gridSize.width), intensitySquareSums(gridSize.width);
+        std::vector<int64_t> laplacianSums(gridSize.width), laplacianSquareSums(gridSize.width);
+        std::vector<int> columnTiles(cols);
+        for (int tx = 0; tx < gridSize.width; ++tx)
+        {
+            const int end = tileStart(tx + 1, gridSize.width, cols);
+            for (int x = tileStart(tx, gridSize.width, cols); x < end; ++x)
+            {
+                columnTiles[x] = tx;
+            }
+        }
+
+        for (int ty = range.start; ty < range.end; ++ty)
+        {
+            std::fill(intensitySums.begin(), intensitySums.end(), 0);
+            std::fill(intensitySquareSums.begin(), intensitySquareSums.end(), 0);
+            std::fill(laplacianSums.begin(), laplacianSums.end(), 0);
+            std::fill(laplacianSquareSums.begin(), laplacianSquareSums.end(), 0);
+
+            const int yStart = tileStart(ty, gridSize.height, rows);
+            const int yEnd = tileStart(ty + 1, gridSize.height, rows);
+            for (int y = yStart; y < yEnd; ++y)
+            {
+                const uchar* up = gray.ptr<uchar>(y - 1);
+                const uchar* center = gray.ptr<uchar>(y);
+                const uchar* down = gray.ptr<uchar>(y + 1);
+
+                for (int x = 1; x < cols - 1; ++x)
+                {
+                    const int p = center[x];
+                    const int laplacian = up[x] + down[x] + center[x - 1] + center[x + 1] - 4 * p;
+                    const int tx = columnTiles[x];
+                    intensitySums[tx] += p;
+                    intensitySquareSums[tx] += p * p;
+                    laplacianSums[tx] += laplacian;
+                    laplacianSquareSums[tx] += laplacian * laplacian;
+                }
+            }
+
+            for (int tx = 0; tx < gridSize.width; ++tx)
+            {
+                const double count = static_cast<double>(yEnd - yStart) *
+                                     (tileStart(tx + 1, gridSize.width, cols) - tileStart(tx, gridSize.width, cols));
+                if (count <= 0)
+                {
+                    continue;
+                }
+
+                const double intensityMean = intensitySums[tx] / count;
+                const double laplacianMean = laplacianSums[tx] / count;
+                result.contrast.at<float>(ty, tx) =
+                        static_cast<float>(intensitySquareSums[tx] / count - intensityMean * intensityMean);
+                result.sharpness.at<float>(ty, tx) =
+                        static_cast<float>(laplacianSquareSums[tx] / count - laplacianMean * laplacianMean);
+            }
+        }
+    });
+
+    // Blank paper has no detail to judge focus by, so only text-bearing tiles vote
+    double totalWeight = 0.0, blurredWeight = 0.0;
+    for (int ty = 0; ty < gridSize.height; ++ty)
+    {
+        for (int tx = 0; tx < gridSize.width; ++tx)
+        {
+            const double contrast = result.contrast.at<float>(ty, tx);
+            if (contrast < minContrast)
+            {
+                continue;
+            }
+
+            totalWeight += contrast;
+            if (result.sharpness.at<float>(ty, tx) < threshold)
+            {
+                blurredWeight += contrast;
+            }
+        }
+    }
+
+    if (totalWeight > 0.0)
+    {
+        result.blurredFraction = blurredWeight / totalWeight;
+    }
+    return result;
 }
 
 bool prl::isBlurred(const cv::Mat& inputImage)
 {
-    //TODO: find constants for blurring check for every algorithm. Write supertest, powered by all algorithms
-    return false;
+    return detectBlur(inputImage).isBlurred;
 }
-
@@ -30,7 +30,64 @@
 namespace prl
 {
 
+/*!
+ * \brief Result of blur detection.
+ */
+struct BlurDetectionResult
+{
+    //! Sharpness score, Laplacian variance of the reduced page
+    double score;
+    bool isBlurred;
+};
+
+/*!
+ * \brief Detect blurred page.
+ * \param[in] inputImage Gray or BGR image.
+ * \param[in] threshold Pages with score below threshold are blurred.
+ * \details Page is reduced so that its longer side is at most 1024 pixels, so cost hardly depends
+ * on capture resolution. Default threshold is calibrated on test_data/blurred (17 images) against
+ * photos of test_data/auto_crop (16 images): 4 blurred images are missed, 1 sharp photo of a blank
+ * sheet is reported as blurred.
+ */
+CV_EXPORTS BlurDetectionResult detectBlur(const cv::Mat& inputImage, double threshold = 55.0);
+
+/*!
+ * \brief Per-tile sharpness of the page.
+ */
+struct FocusMap
+{
+    //! CV_32FC1 grid with Laplacian variance of every tile
+    cv::Mat sharpness;
+    //! CV_32FC1 grid with intensity variance of every tile
+    cv::Mat contrast;
+    //! Blurred share of text-bearing tiles weighted by their contrast, 0 if there is no text
+    double blurredFraction;
+};
+
+/*!
+ * \brief Compute focus map of the page for localized blur detection.
+ * \param[in] inputImage Gray or BGR image.
+ * \param[in] gridSize Number of tiles along each axis.
+ * \param[in] threshold Tiles with Laplacian variance below threshold are blurred.
+ * \param[in] minContrast Tiles with smaller intensity variance are treated as blank paper.
+ * \details Page is reduced as in detectBlur(), Laplacian of every pixel is computed once
+ * and accumulated into its tile.
+ */
+CV_EXPORTS FocusMap focusMap(const cv::Mat& inputImage, cv::Size gridSize = cv::Size(16, 16),
+                             double threshold = 100.0, double minContrast = 100.0);
+
+/*!
+ * \brief Check whether page is blurred, see detectBlur().
+ */
 CV_EXPORTS bool isBlurred(const cv::Mat& inputImage);
 
+/*!
+ * \brief Sharpness measure: variance of Laplacian of gray image (LAPV, Pech2000).
+ * \param[in] inputImage Gray or BGR image.
+ * \return Variance of Laplacian, larger values mean sharper image. Border pixels of 8-bit images
+ * are not measured.
+ */
+CV_EXPORTS double laplacianVariance(const cv::Mat& inputImage);
+
 }
 #endif //PRLIB_BLURDETECTION_HPP
@@ -0,0 +1,309 @@
+/*
+    MIT License
+
+    Copyright (c) 2017 Alexander Zaitsev
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "captureQuality.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "autoCrop.h"
+#include "glareDetection.h"
+
+//! Longer side of the base pyramid level, the same as in blur detection
+static const int CAPTURE_BASE_MAX_SIDE = 1024;
+//! Pages with Laplacian variance below threshold are blurred, the same as the default of detectBlur()
+static const double CAPTURE_BLUR_THRESHOLD = 55.0;
+//! Pages with smaller contrast are rejected
+static const double CAPTURE_MIN_CONTRAST = 0.25;
+//! Pages skewed more than that (in degrees) are rejected
+static const double CAPTURE_MAX_SKEW = 5.0;
+//! Pixel is dark if it is that much darker than the median (paper) intensity
+static const int BLANK_INK_OFFSET = 40;
+//! Pages with smaller share of dark pixels are blank
+static const double BLANK_MAX_INK_FRACTION = 0.002;
+//! Width of skew histogram bin in degrees
+static const double SKEW_BIN_WIDTH = 0.5;
+//! Smallest squared Sobel magnitude of pixel voting for skew
+static const int SKEW_MIN_SQUARED_GRADIENT = 100 * 100;
+//! Step between pixels voting for skew along both axes, the same vote density as at the half of base level
+static const int SKEW_VOTE_STEP = 2;
+
+static double elapsedMilliseconds(int64 startTicks)
+{
+    return 1000.0 * (cv::getTickCount() - startTicks) / cv::getTickFrequency();
+}
+
+//! Intensity below which given share of pixels lies
+static int histogramPercentile(const std::vector<int>& histogram, int64 total, double fraction)
+{
+    const double target = fraction * total;
+    int64 count = 0;
+    for (int value = 0; value < 256; ++value)
+    {
+        count += histogram[value];
+        if (count > target)
+        {
+            return value;
+        }
+    }
+    return 255;
+}
+
+//! Skew from histogram of gradient orientations folded to [0; 90) degrees
+static double skewFromHistogram(const std::vector<double>& histogram)
+{
+    const int bins = static_cast<int>(histogram.size());
+
+    // Circular smoothing, 0 and 90 degrees are the same orientation
+    std::vector<double> smoothed(bins);
+    for (int i = 0; i < bins; ++i)
+    {
+        smoothed[i] = histogram[(i + bins - 1) % bins] + 2.0 * histogram[i] + histogram[(i + 1) % bins];
+    }
+
+    const int peak = static_cast<int>(std::max_element(smoothed.begin(), smoothed.end()) - smoothed.begin());
+    if (smoothed[peak] <= 0.0)
+    {
+        return 0.0;
+    }
+
+    // Parabolic refinement of the peak
+    const double left = smoothed[(peak + bins - 1) % bins];
+    const double right = smoothed[(peak + 1) % bins];
+    const double denominator = left - 2.0 * smoothed[peak] + right;
+    const double offset = denominator < 0.0 ? 0.5 * (left - right) / denominator : 0.0;
+
+    double angle = (peak + 0.5 + offset) * SKEW_BIN_WIDTH;
+    if (angle >= 45.0)
+    {
+        angle -= 90.0;
+    }
+    return angle;
+}
+
+/*!
+ * \brief Blur score and skew from one pass over 3x3 neighbourhoods of gray image.
+ * \details Blur score is the Laplacian variance, the same as laplacianVariance(). Sobel gradients
+ * of the same neighbourhoods vote into magnitude weighted histogram of orientations. Both text
+ * baselines and vertical strokes give gradients orthogonal to the text direction, so orientations
+ * folded to [-45; 45) degrees peak at the skew angle.
+ */
+static void gradientStatistics(const cv::Mat& grayImage, double& blurScore, double& skewAngle)
+{
+    blurScore = 0.0;
+    skewAngle = 0.0;
+
+    const int rows = grayImage.rows;
+    const int cols = grayImage.cols;
+    if (rows < 3 || cols < 3)
+    {
+        return;
+    }
+
+    const int bins = cvRound(90.0 / SKEW_BIN_WIDTH);
+    std::vector<double> histogram(bins, 0.0);
+    int64 laplacianSum = 0;
+    int64 laplacianSquareSum = 0;
+
+    for (int y = 1; y < rows - 1; ++y)
+    {
+        const uchar* up = grayImage.ptr<uchar>(y - 1);
+        const uchar* center = grayImage.ptr<uchar>(y);
+        const uchar* down = grayImage.ptr<uchar>(y + 1);
+
+        for (int x = 1; x < cols - 1; ++x)
+        {
+            const int laplacian = up[x] + down[x] + center[x - 1] + center[x + 1] - 4 * center[x];
+            laplacianSum += laplacian;
+            laplacianSquareSum += laplacian * laplacian;
+        }
+
+        //! Rows are still in cache, every second pixel of every second row votes
+        if (y % SKEW_VOTE_STEP != 0)
+        {
+            continue;
+        }
+
+        for (int x = 1; x < cols - 1; x += SKEW_VOTE_STEP)
+        {
+            const int gx = (up[x + 1] - up[x - 1]) + 2 * (center[x + 1] - center[x - 1]) + (down[x + 1] - down[x - 1]);
+            const int gy = (down[x - 1] - up[x - 1]) + 2 * (down[x] - up[x]) + (down[x + 1] - up[x + 1]);
+            const int squaredMagnitude = gx * gx + gy * gy;
+            if (squaredMagnitude < SKEW_MIN_SQUARED_GRADIENT)
+            {
+                continue;
+            }
+
+            // Orientation in [0; 90), 0 is the axis-aligned page
+            const double angle = std::fmod(static_cast<double>(cv::fastAtan2(static_cast<float>(gy),
+                                                                             static_cast<float>(gx))), 90.0);
+            histogram[std::min(bins - 1, static_cast<int>(angle / SKEW_BIN_WIDTH))] += std::sqrt(squaredMagnitude);
+        }
+    }
+
+    const double count = static_cast<double>(rows - 2) * (cols - 2);
+    const double laplacianMean = laplacianSum / count;
+    blurScore = laplacianSquareSum / count - laplacianMean * laplacianMean;
+    skewAngle = skewFromHistogram(histogram);
+}
+
+prl::CaptureQuality prl::assessCapture(const cv::Mat& inputImage)
+{
+    if (inputImage.empty())
+    {
+        throw std::invalid_argument("Input image for capture assessment is empty");
+    }
+
+    if (inputImage.depth() != CV_8U || (inputImage.channels() != 1 && inputImage.channels() != 3 &&
+                                        inputImage.channels() != 4))
+    {
+        throw std::invalid_argument("Capture assessment supports only 8-bit gray, BGR or BGRA images");
+    }
+
+    const int64 totalTicks = cv::getTickCount();
+    CaptureQuality quality;
+
+    //! Pyramid: the only pass over full resolution image
+    int64 startTicks = cv::getTickCount();
+    cv::Mat base = inputImage;
+    const int maxSide = std::max(inputImage.cols, inputImage.rows);
+    if (maxSide > CAPTURE_BASE_MAX_SIDE)
+    {
+        const int factor = (maxSide + CAPTURE_BASE_MAX_SIDE - 1) / CAPTURE_BASE_MAX_SIDE;
+        cv::resize(inputImage, base, cv::Size(std::max(1, inputImage.cols / factor),
+                                              std::max(1, inputImage.rows / factor)), 0, 0, cv::INTER_AREA);
+    }
+
+    cv::Mat small;
+    cv::resize(base, small, cv::Size(std::max(1, base.cols / 2), std::max(1, base.rows / 2)), 0, 0, cv::INTER_AREA);
+
+    cv::Mat baseGray;
+    if (base.channels() == 1)
+    {
+        baseGray = base;
+    }
+    else
+    {
+        cv::cvtColor(base, baseGray, base.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+    }
+
+    //! Glare planes of the small level, computed once instead of inside detectGlare()
+    cv::Mat smallBrightness, smallChroma, smallGray;
+    brightnessPlanes(small, smallBrightness, smallChroma, smallGray);
+    quality.timings.pyramid = elapsedMilliseconds(startTicks);
+
+    const double smallScaleX = static_cast<double>(inputImage.cols) / small.cols;
+    const double smallScaleY = static_cast<double>(inputImage.rows) / small.rows;
+
+    //! Every check writes only its own fields, so they can run concurrently
+    const std::vector<std::function<void()>> checks = {
+        [&]()
+        {
+            const int64 ticks = cv::getTickCount();
+            gradientStatistics(baseGray, quality.blurScore, quality.skewAngle);
+            quality.isBlurred = quality.blurScore < CAPTURE_BLUR_THRESHOLD;
+            quality.isSkewed = std::abs(quality.skewAngle) > CAPTURE_MAX_SKEW;
+            quality.timings.gradients = elapsedMilliseconds(ticks);
+        },
+        [&]()
+        {
+            const int64 ticks = cv::getTickCount();
+            const GlareDetectionResult glare = detectGlare(smallBrightness, smallChroma, smallGray);
+            quality.glareFraction = glare.glareFraction;
+            quality.isGlared = glare.isGlared;
+            for (const cv::Rect& region : glare.regions)
+            {
+                const cv::Rect scaled(cvFloor(region.x * smallScaleX), cvFloor(region.y * smallScaleY),
+                                      cvCeil(region.width * smallScaleX), cvCeil(region.height * smallScaleY));
+                quality.glareRegions.push_back(scaled & cv::Rect(0, 0, inputImage.cols, inputImage.rows));
+            }
+            quality.timings.glare = elapsedMilliseconds(ticks);
+        },
+        [&]()
+        {
+            //! One histogram for contrast and blank page checks
+            const int64 ticks = cv::getTickCount();
+            std::vector<int> histogram(256, 0);
+            for (int y = 0; y < baseGray.rows; ++y)
+            {
+                const uchar* row = baseGray.ptr<uchar>(y);
+                for (int x = 0; x < baseGray.cols; ++x)
+                {
+                    ++histogram[row[x]];
+                }
+            }
+
+            const int64 total = static_cast<int64>(baseGray.total());
+            const int low = histogramPercentile(histogram, total, 0.05);
+            const int median = histogramPercentile(histogram, total, 0.5);
+            const int high = histogramPercentile(histogram, total, 0.95);
+            quality.contrast = (high - low) / 255.0;
+            quality.isLowContrast = quality.contrast < CAPTURE_MIN_CONTRAST;
+
+            int64 inkPixels = 0;
+            for (int value = 0; value < median - BLANK_INK_OFFSET; ++value)
+            {
+                inkPixels += histogram[value];
+            }
+            quality.isBlank = inkPixels < BLANK_MAX_INK_FRACTION * total;
+            quality.timings.contrast = elapsedMilliseconds(ticks);
+        },
+        [&]()
+        {
+            const int64 ticks = cv::getTickCount();
+            cv::Mat documentImage = small.channels() == 4 ? cv::Mat() : small;
+            if (documentImage.empty())
+            {
+                cv::cvtColor(small, documentImage, cv::COLOR_BGRA2BGR);
+            }
+
+            std::vector<cv::Point2f> contour;
+            if (documentContour(documentImage, -1, -1, contour))
+            {
+                for (cv::Point2f& point : contour)
+                {
+                    point.x = static_cast<float>(point.x * smallScaleX);
+                    point.y = static_cast<float>(point.y * smallScaleY);
+                }
+                quality.documentContour = contour;
+            }
+            quality.timings.document = elapsedMilliseconds(ticks);
+        }
+    };
+
+    cv::parallel_for_(cv::Range(0, static_cast<int>(checks.size())), [&](const cv::Range& range)
+    {
+        for (int i = range.start; i < range.end; ++i)
+        {
+            checks[i]();
+        }
+    }, static_cast<double>(checks.size()));
+
+    quality.timings.total = elapsedMilliseconds(totalTicks);
+    return quality;
+}
@@ -0,0 +1,93 @@
+/*
+    MIT License
+
+    Copyright (c) 2017 Alexander Zaitsev
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef PRLIB_CAPTUREQUALITY_HPP
+#define PRLIB_CAPTUREQUALITY_HPP
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace prl
+{
+
+/*!
+ * \brief Time spent on every step of capture assessment, in milliseconds.
+ */
+struct CaptureTimings
+{
+    double pyramid;
+    //! Blur and skew, one pass over the base level
+    double gradients;
+    double glare;
+    double contrast;
+    double document;
+    double total;
+};
+
+/*!
+ * \brief Capture quality report.
+ */
+struct CaptureQuality
+{
+    //! Laplacian variance of the reduced page, see detectBlur()
+    double blurScore;
+    bool isBlurred;
+
+    //! Share of page covered by glare, see detectGlare()
+    double glareFraction;
+    bool isGlared;
+    //! Glare regions in input image coordinates
+    std::vector<cv::Rect> glareRegions;
+
+    //! Distance between 5th and 95th intensity percentiles divided by 255
+    double contrast;
+    bool isLowContrast;
+
+    //! Dominant text skew in degrees, the same convention as findAngle()
+    double skewAngle;
+    bool isSkewed;
+
+    //! True if page has almost no dark pixels
+    bool isBlank;
+
+    //! Document quadrilateral in input image coordinates, empty if not found
+    std::vector<cv::Point2f> documentContour;
+
+    CaptureTimings timings;
+};
+
+/*!
+ * \brief Assess quality of mobile capture in one pass.
+ * \param[in] inputImage Gray, BGR or BGRA 8-bit image.
+ * \details One reduced pyramid is built, then all checks are scheduled in parallel on its levels.
+ * Gray histogram is shared by contrast and blank page checks. Laplacian for blur and Sobel gradients
+ * for skew come from the same pass over the base level. Glare planes of the small level are computed
+ * with the pyramid.
+ */
+CV_EXPORTS CaptureQuality assessCapture(const cv::Mat& inputImage);
+
+}
+
+#endif //PRLIB_CAPTUREQUALITY_HPP
@@ -24,7 +24,267 @@
 
 #include "glareDetection.h"
 
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+//! Longer side of the page used for glare detection
+static const int GLARE_MAX_SIDE = 512;
+//! Smallest value of max(B, G, R) treated as near-clipped
+static const int GLARE_MIN_VALUE = 245;
+//! Paper level is this percentile of max(B, G, R) over the page
+static const double GLARE_PAPER_PERCENTILE = 0.5;
+//! Glare must be brighter than paper level by at least this
+static const int GLARE_MIN_EXCESS = 12;
+//! Largest max(B, G, R) - min(B, G, R) of glare pixel at the smallest glare value
+static const int GLARE_MAX_CHROMA = 24;
+//! Smallest glare region as share of page area
+static const double GLARE_MIN_AREA_FRACTION = 0.001;
+//! Larger regions are page background (e.g. white paper), not glare
+static const double GLARE_MAX_AREA_FRACTION = 0.25;
+//! Window of local variance map
+static const int TEXT_WINDOW_SIZE = 7;
+//! Smallest local intensity variance of text-bearing pixel
+static const float TEXT_MIN_VARIANCE = 150.0f;
+//! Smallest share of text-bearing pixels around region
+static const double TEXT_MIN_FRACTION = 0.05;
+
+void prl::brightnessPlanes(const cv::Mat& reduced, cv::Mat& brightness, cv::Mat& chroma, cv::Mat& gray)
+{
+    const int channels = reduced.channels();
+    if (channels == 1)
+    {
+        brightness = reduced;
+        chroma = cv::Mat::zeros(reduced.size(), CV_8UC1);
+        gray = reduced;
+        return;
+    }
+
+    brightness.create(reduced.size(), CV_8UC1);
+    chroma.create(reduced.size(), CV_8UC1);
+    gray.create(reduced.size(), CV_8UC1);
+
+    for (int y = 0; y < reduced.rows; ++y)
+    {
+        const uchar* src = reduced.ptr<uchar>(y);
+        uchar* brightnessRow = brightness.ptr<uchar>(y);
+        uchar* chromaRow = chroma.ptr<uchar>(y);
+        uchar* grayRow = gray.ptr<uchar>(y);
+
+        for (int x = 0; x < reduced.cols; ++x, src += channels)
+        {
+            const int b = src[0], g = src[1], r = src[2];
+            const int maxValue = std::max(b, std::max(g, r));
+            brightnessRow[x] = static_cast<uchar>(maxValue);
+            chromaRow[x] = static_cast<uchar>(maxValue - std::min(b, std::min(g, r)));
+            // Same weights as cv::COLOR_BGR2GRAY in fixed point
+            grayRow[x] = static_cast<uchar>((b * 1868 + g * 9617 + r * 4899 + (1 << 13)) >> 14);
+        }
+    }
+}
+
+// Smallest value which is not exceeded by the given share of pixels of 8-bit image
+static int percentileValue(const cv::Mat& image, double percentile)
+{
+    int histogram[256] = {0};
+    for (int y = 0; y < image.rows; ++y)
+    {
+        const uchar* row = image.ptr<uchar>(y);
+        for (int x = 0; x < image.cols; ++x)
+        {
+            ++histogram[row[x]];
+        }
+    }
+
+    const double target = percentile * image.total();
+    double count = 0.0;
+    for (int value = 0; value < 256; ++value)
+    {
+        count += histogram[value];
+        if (count >= target)
+        {
+            return value;
+        }
+    }
+    return 255;
+}
+
+// Near-clipped pixels from minValue up. Chroma tolerance grows towards white, because clipped channels
+// converge there.
+static void glareMask(const cv::Mat& brightness, const cv::Mat& chroma, int minValue, cv::Mat& mask)
+{
+    int maxChroma[256];
+    for (int value = 0; value < 256; ++value)
+    {
+        maxChroma[value] = value >= minValue ? GLARE_MAX_CHROMA + (value - minValue) : -1;
+    }
+
+    mask.create(brightness.size(), CV_8UC1);
+    for (int y = 0; y < brightness.rows; ++y)
+    {
+        const uchar* brightnessRow = brightness.ptr<uchar>(y);
+        const uchar* chromaRow = chroma.ptr<uchar>(y);
+        uchar* maskRow = mask.ptr<uchar>(y);
+        for (int x = 0; x < brightness.cols; ++x)
+        {
+            maskRow[x] = chromaRow[x] <= maxChroma[brightnessRow[x]] ? 255 : 0;
+        }
+    }
+}
+
+prl::GlareDetectionResult prl::detectGlare(const cv::Mat& inputImage)
+{
+    if (inputImage.empty())
+    {
+        throw std::invalid_argument("Input image for glare detection is empty");
+    }
+
+    if (inputImage.depth() != CV_8U || (inputImage.channels() != 1 && inputImage.channels() != 3 &&
+                                        inputImage.channels() != 4))
+    {
+        throw std::invalid_argument("Glare detection supports only 8-bit gray, BGR or BGRA images");
+    }
+
+    // Glare blobs are large, so nearest neighbour reduction loses nothing and reads few pixels
+    cv::Mat reduced = inputImage;
+    const int maxSide = std::max(inputImage.cols, inputImage.rows);
+    if (maxSide > GLARE_MAX_SIDE)
+    {
+        const double scale = static_cast<double>(GLARE_MAX_SIDE) / maxSide;
+        cv::resize(inputImage, reduced, cv::Size(), scale, scale, cv::INTER_NEAREST);
+    }
+    const double scaleX = static_cast<double>(inputImage.cols) / reduced.cols;
+    const double scaleY = static_cast<double>(inputImage.rows) / reduced.rows;
+
+    cv::Mat brightness, chroma, gray;
+    brightnessPlanes(reduced, brightness, chroma, gray);
+
+    GlareDetectionResult result = detectGlare(brightness, chroma, gray);
+    for (cv::Rect& region : result.regions)
+    {
+        const cv::Rect scaled(cvFloor(region.x * scaleX), cvFloor(region.y * scaleY),
+                              cvCeil(region.width * scaleX), cvCeil(region.height * scaleY));
+        region = scaled & cv::Rect(0, 0, inputImage.cols, inputImage.rows);
+    }
+
+    return result;
+}
+
+prl::GlareDetectionResult prl::detectGlare(const cv::Mat& brightness, const cv::Mat& chroma, const cv::Mat& gray)
+{
+    if (brightness.empty() || brightness.type() != CV_8UC1 || chroma.size() != brightness.size() ||
+        chroma.type() != CV_8UC1 || gray.size() != brightness.size() || gray.type() != CV_8UC1)
+    {
+        throw std::invalid_argument("Glare detection needs 8-bit brightness, chroma and gray planes of the same size");
+    }
+
+    // White paper is near-clipped itself, so glare has to stand out above the paper level
+    const int paperLevel = percentileValue(brightness, GLARE_PAPER_PERCENTILE);
+    const int minValue = std::max(GLARE_MIN_VALUE, paperLevel + GLARE_MIN_EXCESS);
+
+    GlareDetectionResult result;
+    result.isGlared = false;
+    result.glareFraction = 0.0;
+    if (minValue > 255)
+    {
+        return result;
+    }
+
+    cv::Mat mask;
+    glareMask(brightness, chroma, minValue, mask);
+
+    cv::Mat labels, stats, centroids;
+    const int labelsCount = cv::connectedComponentsWithStats(mask, labels, stats, centroids, 8, CV_32S);
+    if (labelsCount <= 1)
+    {
+        return result;
+    }
+
+    // Tiny specks and page background are dropped before text is measured, so that text on white paper
+    // is not hidden by the paper itself
+    const double pageArea = static_cast<double>(brightness.rows) * brightness.cols;
+    std::vector<uchar> isGlareLabel(labelsCount, 0);
+    bool hasGlare = false;
+    for (int label = 1; label < labelsCount; ++label)
+    {
+        const int area = stats.at<int>(label, cv::CC_STAT_AREA);
+        if (area >= GLARE_MIN_AREA_FRACTION * pageArea && area <= GLARE_MAX_AREA_FRACTION * pageArea)
+        {
+            isGlareLabel[label] = 255;
+            hasGlare = true;
+        }
+    }
+
+    if (!hasGlare)
+    {
+        return result;
+    }
+
+    cv::Mat glareRegions(labels.size(), CV_8UC1);
+    for (int y = 0; y < labels.rows; ++y)
+    {
+        const int* labelsRow = labels.ptr<int>(y);
+        uchar* regionsRow = glareRegions.ptr<uchar>(y);
+        for (int x = 0; x < labels.cols; ++x)
+        {
+            regionsRow[x] = isGlareLabel[labelsRow[x]];
+        }
+    }
+
+    // Local variance map, text-bearing pixels are counted by integral image
+    cv::Mat grayFloat, mean, squareMean;
+    gray.convertTo(grayFloat, CV_32F);
+    const cv::Size window(TEXT_WINDOW_SIZE, TEXT_WINDOW_SIZE);
+    cv::boxFilter(grayFloat, mean, CV_32F, window, cv::Point(-1, -1), true, cv::BORDER_REPLICATE);
+    cv::boxFilter(grayFloat.mul(grayFloat), squareMean, CV_32F, window, cv::Point(-1, -1), true,
+                  cv::BORDER_REPLICATE);
+    cv::Mat textMask = (squareMean - mean.mul(mean)) >= TEXT_MIN_VARIANCE;
+
+    // Edges of glare regions have high variance too, they are not text
+    cv::Mat grownMask;
+    cv::dilate(glareRegions, grownMask, cv::getStructuringElement(cv::MORPH_RECT, window));
+    textMask.setTo(0, grownMask);
+    cv::Mat textIntegral;
+    cv::integral(textMask / 255, textIntegral, CV_32S);
+
+    const cv::Rect page(0, 0, brightness.cols, brightness.rows);
+    double glareArea = 0.0;
+    for (int label = 1; label < labelsCount; ++label)
+    {
+        if (!isGlareLabel[label])
+        {
+            continue;
+        }
+
+        const int area = stats.at<int>(label, cv::CC_STAT_AREA);
+
+        const cv::Rect region(stats.at<int>(label, cv::CC_STAT_LEFT), stats.at<int>(label, cv::CC_STAT_TOP),
+                              stats.at<int>(label, cv::CC_STAT_WIDTH), stats.at<int>(label, cv::CC_STAT_HEIGHT));
+        glareArea += area;
+
+        // Text under the glare is washed out, so look at the surrounding band as well
+        const int margin = std::max(region.width, region.height) / 4 + TEXT_WINDOW_SIZE;
+        const cv::Rect neighbourhood = cv::Rect(region.x - margin, region.y - margin,
+                                                region.width + 2 * margin, region.height + 2 * margin) & page;
+        const int textPixels = textIntegral.at<int>(neighbourhood.br()) -
+                               textIntegral.at<int>(neighbourhood.y, neighbourhood.br().x) -
+                               textIntegral.at<int>(neighbourhood.br().y, neighbourhood.x) +
+                               textIntegral.at<int>(neighbourhood.tl());
+        if (textPixels >= TEXT_MIN_FRACTION * neighbourhood.area())
+        {
+            result.isGlared = true;
+        }
+
+        result.regions.push_back(region);
+    }
+
+    result.glareFraction = glareArea / pageArea;
+    return result;
+}
+
 bool prl::isGlared(const cv::Mat& inputImage)
 {
-    return false;
-}
\ No newline at end of file
+    return detectGlare(inputImage).isGlared;
+}
@@ -25,11 +25,60 @@
 #ifndef PRLIB_GLAREDETECTION_HPP
 #define PRLIB_GLAREDETECTION_HPP
 
+#include <vector>
+
 #include <opencv2/core/core.hpp>
 
 namespace prl
 {
+
+/*!
+ * \brief Result of glare detection.
+ */
+struct GlareDetectionResult
+{
+    //! True if some glare region covers text-bearing area
+    bool isGlared;
+    //! Bounding boxes of glare regions in input image coordinates
+    std::vector<cv::Rect> regions;
+    //! Share of page covered by glare regions
+    double glareFraction;
+};
+
+/*!
+ * \brief Detect flash glare on the page.
+ * \param[in] inputImage Gray or BGR image.
+ * \details Paper level is estimated as the median of max(B, G, R) of the reduced page. Near-clipped
+ * low-chroma pixels clearly brighter than paper are labeled into regions, regions covering a quarter
+ * of the page or more are page background. Remaining regions next to text-bearing area
+ * (high local variance) mark the page as glared. Glare on paper which is itself almost clipped
+ * cannot be told apart and is not reported.
+ */
+CV_EXPORTS GlareDetectionResult detectGlare(const cv::Mat& inputImage);
+
+/*!
+ * \brief Detect flash glare on brightness planes of already reduced page, see detectGlare().
+ * \param[in] brightness max(B, G, R) of the page, 8-bit.
+ * \param[in] chroma max(B, G, R) - min(B, G, R) of the page, 8-bit.
+ * \param[in] gray Gray page, 8-bit.
+ * \details Regions are returned in coordinates of the planes.
+ */
+CV_EXPORTS GlareDetectionResult detectGlare(const cv::Mat& brightness, const cv::Mat& chroma, const cv::Mat& gray);
+
+/*!
+ * \brief Brightness, chroma and gray planes of the page in one pass.
+ * \param[in] inputImage Gray, BGR or BGRA 8-bit image.
+ * \param[out] brightness max(B, G, R), the image itself for gray input.
+ * \param[out] chroma max(B, G, R) - min(B, G, R), zeros for gray input.
+ * \param[out] gray The same as cv::COLOR_BGR2GRAY conversion.
+ */
+CV_EXPORTS void brightnessPlanes(const cv::Mat& inputImage, cv::Mat& brightness, cv::Mat& chroma, cv::Mat& gray);
+
+/*!
+ * \brief Check whether page has glare over text, see detectGlare().
+ */
 CV_EXPORTS bool isGlared(const cv::Mat& inputImage);
+
 }
 
 #endif //PRLIB_GLAREDETECTION_HPP
@@ -32,188 +32,448 @@
 
 #endif
 
+#include <algorithm>
+#include <cstring>
+
 #include "leptonica/allheaders.h"
 
+#if CV_SSE2
+#include <emmintrin.h>
+#endif
 
-Pix* prl::opencvToLeptonica(const cv::Mat* inputImage)
+#if CV_SSSE3
+#include <tmmintrin.h>
+#endif
+
+//! Images with at least this count of pixels are converted by several threads
+static const size_t CONVERT_PARALLEL_MIN_PIXELS = 1 << 20;
+
+//! Run rowFunction(y) for every row, in parallel for large images
+template <typename RowFunction>
+static void forEachRow(int rows, int cols, const RowFunction& rowFunction)
 {
-    const unsigned char* imagedata = inputImage->data;
-    int width = inputImage->size().width;
-    int height = inputImage->size().height;
-    int bytes_per_pixel = inputImage->channels();
-    int bytes_per_line = inputImage->step;
+    auto body = [&rowFunction](const cv::Range& range)
+    {
+        for (int y = range.start; y < range.end; ++y)
+        {
+            rowFunction(y);
+        }
+    };
 
-    //The following code is based on tesseract's ImageThresholder.SetImage function
-    int bpp = bytes_per_pixel * 8;
-    if (bpp == 0)
+    if (static_cast<size_t>(rows) * cols >= CONVERT_PARALLEL_MIN_PIXELS)
     {
-        bpp = 1;
+        cv::parallel_for_(cv::Range(0, rows), body);
     }
-    Pix* pix = pixCreate(width, height, bpp == 24 ? 32 : bpp);
-    l_uint32* data = pixGetData(pix);
-    int wpl = pixGetWpl(pix);
-    switch (bpp)
+    else
     {
-        case 1:
-            for (int y = 0; y < height; ++y, data += wpl, imagedata += bytes_per_line)
+        body(cv::Range(0, rows));
+    }
+}
+
+//! Leptonica keeps the leftmost pixel in the most significant byte of a word
+static inline l_uint32 toLeptonicaByteOrder(l_uint32 word)
+{
+#ifdef L_BIG_ENDIAN
+    return word;
+#else
+    return (word >> 24) | ((word >> 8) & 0x0000ff00u) | ((word << 8) & 0x00ff0000u) | (word << 24);
+#endif
+}
+
+//! Copy 8-bit row to PIX8 line
+static void grayRowToPix(const uchar* src, l_uint32* dst, int width)
+{
+    const int words = width / 4;
+    for (int i = 0; i < words; ++i)
+    {
+        l_uint32 word;
+        std::memcpy(&word, src + 4 * i, sizeof(word));
+        dst[i] = toLeptonicaByteOrder(word);
+    }
+
+    if (4 * words < width)
+    {
+        dst[words] = 0;
+    }
+
+    for (int x = 4 * words; x < width; ++x)
+    {
+        SET_DATA_BYTE(dst, x, src[x]);
+    }
+}
+
+//! Copy PIX8 line to 8-bit row
+static void pixRowToGray(const l_uint32* src, uchar* dst, int width)
+{
+    const int words = width / 4;
+    for (int i = 0; i < words; ++i)
+    {
+        const l_uint32 word = toLeptonicaByteOrder(src[i]);
+        std::memcpy(dst + 4 * i, &word, sizeof(word));
+    }
+
+    for (int x = 4 * words; x < width; ++x)
+    {
+        dst[x] = GET_DATA_BYTE(src, x);
+    }
+}
+
+//! Convert BGR row to PIX32 line (RGB pixels, alpha byte is zero)
+static void bgrRowToPix(const uchar* src, l_uint32* dst, int width)
+{
+    int x = 0;
+
+#if CV_SSSE3 && !defined(L_BIG_ENDIAN)
+    //! 4 pixels per step, 16 bytes are read, so the last 2 pixels of a row are left for scalar loop
+    const __m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    for (; x + 6 <= width; x += 4)
+    {
+        const __m128i bgr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * x));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_shuffle_epi8(bgr, shuffle));
+    }
+#endif
+
+    for (; x < width; ++x)
+    {
+        dst[x] = (static_cast<l_uint32>(src[3 * x + 2]) << L_RED_SHIFT) |
+                 (static_cast<l_uint32>(src[3 * x + 1]) << L_GREEN_SHIFT) |
+                 (static_cast<l_uint32>(src[3 * x]) << L_BLUE_SHIFT);
+    }
+}
+
+//! Convert BGRA row to PIX32 line (RGBA pixels)
+static void bgraRowToPix(const uchar* src, l_uint32* dst, int width)
+{
+    for (int x = 0; x < width; ++x)
+    {
+        dst[x] = (static_cast<l_uint32>(src[4 * x + 2]) << L_RED_SHIFT) |
+                 (static_cast<l_uint32>(src[4 * x + 1]) << L_GREEN_SHIFT) |
+                 (static_cast<l_uint32>(src[4 * x]) << L_BLUE_SHIFT) |
+                 (static_cast<l_uint32>(src[4 * x + 3]) << L_ALPHA_SHIFT);
+    }
+}
+
+//! Convert PIX32 line to BGR row
+static void pixRowToBgr(const l_uint32* src, uchar* dst, int width)
+{
+    int x = 0;
+
+#if CV_SSSE3 && !defined(L_BIG_ENDIAN)
+    const __m128i shuffle = _mm_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1);
+    for (; x + 4 <= width; x += 4)
+    {
+        const __m128i rgba = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        const __m128i bgr = _mm_shuffle_epi8(rgba, shuffle);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + 3 * x), bgr);
+        const int tail = _mm_cvtsi128_si32(_mm_srli_si128(bgr, 8));
+        std::memcpy(dst + 3 * x + 8, &tail, sizeof(tail));
+    }
+#endif
+
+    for (; x < width; ++x)
+    {
+        const l_uint32 pixel = src[x];
+        dst[3 * x] = static_cast<uchar>((pixel >> L_BLUE_SHIFT) & 0xff);
+        dst[3 * x + 1] = static_cast<uchar>((pixel >> L_GREEN_SHIFT) & 0xff);
+        dst[3 * x + 2] = static_cast<uchar>((pixel >> L_RED_SHIFT) & 0xff);
+    }
+}
+
+//! Bit reversed bytes
+static const uchar* reversedBits()
+{
+    static const struct Table
+    {
+        uchar values[256];
+
+        Table()
+        {
+            for (int i = 0; i < 256; ++i)
             {
-                for (int x = 0; x < width; ++x)
+                int reversed = 0;
+                for (int bit = 0; bit < 8; ++bit)
                 {
-                    if (imagedata[x / 8] & (0x80 >> (x % 8)))
-                        CLEAR_DATA_BIT(data, x);
-                    else
-                        SET_DATA_BIT(data, x);
+                    reversed |= ((i >> bit) & 1) << (7 - bit);
                 }
+                values[i] = static_cast<uchar>(reversed);
             }
-            break;
+        }
+    } table;
 
-        case 8:
-            // Greyscale just copies the bytes in the right order.
-            for (int y = 0; y < height; ++y, data += wpl, imagedata += bytes_per_line)
-            {
-                for (int x = 0; x < width; ++x)
-                    SET_DATA_BYTE(data, x, imagedata[x]);
-            }
-            break;
+    return table.values;
+}
 
-        case 24:
-            // Put the colors in the correct places in the line buffer.
-            for (int y = 0; y < height; ++y, imagedata += bytes_per_line)
+//! Expanded bytes of PIX1: set bit (black pixel) becomes 0, clear bit becomes 255
+static const uchar* expandedBits()
+{
+    static const struct Table
+    {
+        uchar values[256][8];
+
+        Table()
+        {
+            for (int i = 0; i < 256; ++i)
             {
-                for (int x = 0; x < width; ++x, ++data)
+                for (int bit = 0; bit < 8; ++bit)
                 {
-                    SET_DATA_BYTE(data, COLOR_RED, imagedata[3 * x]);
-                    SET_DATA_BYTE(data, COLOR_GREEN, imagedata[3 * x + 1]);
-                    SET_DATA_BYTE(data, COLOR_BLUE, imagedata[3 * x + 2]);
+                    values[i][bit] = ((i >> (7 - bit)) & 1) ? 0 : 255;
                 }
             }
-            break;
+        }
+    } table;
 
-        case 32:
-            // Maintain byte order consistency across different endianness.
-            for (int y = 0; y < height; ++y, imagedata += bytes_per_line, data += wpl)
+    return &table.values[0][0];
+}
+
+//! Pack 8-bit row to PIX1 line, pixels darker than threshold become set bits
+static void grayRowToBits(const uchar* src, l_uint32* dst, int width, int threshold)
+{
+    const int words = width / 32;
+    int x = 0;
+
+#if CV_SSE2
+    const uchar* reversed = reversedBits();
+    //! Unsigned comparison through signed one: a < b <=> (a ^ 0x80) < (b ^ 0x80)
+    const __m128i signBit = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i bound = _mm_set1_epi8(static_cast<char>(std::min(std::max(threshold, 0), 255) ^ 0x80));
+    const bool isThresholdBelowRange = threshold <= 0;
+    const bool isThresholdAboveRange = threshold > 255;
+
+    for (int i = 0; i < words; ++i, x += 32)
+    {
+        const __m128i low = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x)), signBit);
+        const __m128i high = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x + 16)), signBit);
+
+        l_uint32 mask = static_cast<l_uint32>(_mm_movemask_epi8(_mm_cmplt_epi8(low, bound))) |
+                        (static_cast<l_uint32>(_mm_movemask_epi8(_mm_cmplt_epi8(high, bound))) << 16);
+
+        if (isThresholdBelowRange)
+        {
+            mask = 0;
+        }
+        else if (isThresholdAboveRange)
+        {
+            mask = 0xffffffffu;
+        }
+
+        //! movemask gives the leftmost pixel in the least significant bit
+        dst[i] = (static_cast<l_uint32>(reversed[mask & 0xff]) << 24) |
+                 (static_cast<l_uint32>(reversed[(mask >> 8) & 0xff]) << 16) |
+                 (static_cast<l_uint32>(reversed[(mask >> 16) & 0xff]) << 8) |
+                 static_cast<l_uint32>(reversed[mask >> 24]);
+    }
+#else
+    for (int i = 0; i < words; ++i, x += 32)
+    {
+        l_uint32 word = 0;
+        for (int bit = 0; bit < 32; ++bit)
+        {
+            word |= static_cast<l_uint32>(src[x + bit] < threshold) << (31 - bit);
+        }
+        dst[i] = word;
+    }
+#endif
+
+    if (x < width)
+    {
+        dst[words] = 0;
+        for (; x < width; ++x)
+        {
+            if (src[x] < threshold)
             {
-                for (int x = 0; x < width; ++x)
-                {
-                    data[x] = (imagedata[x * 4] << 24) | (imagedata[x * 4 + 1] << 16) |
-                              (imagedata[x * 4 + 2] << 8) | imagedata[x * 4 + 3];
-                }
+                SET_DATA_BIT(dst, x);
             }
-            break;
+        }
+    }
+}
 
+//! Expand PIX1 line to 8-bit row
+static void bitsRowToGray(const l_uint32* src, uchar* dst, int width)
+{
+    const uchar* expanded = expandedBits();
+
+    const int words = width / 32;
+    for (int i = 0; i < words; ++i)
+    {
+        const l_uint32 word = src[i];
+        uchar* out = dst + 32 * i;
+        std::memcpy(out, expanded + 8 * (word >> 24), 8);
+        std::memcpy(out + 8, expanded + 8 * ((word >> 16) & 0xff), 8);
+        std::memcpy(out + 16, expanded + 8 * ((word >> 8) & 0xff), 8);
+        std::memcpy(out + 24, expanded + 8 * (word & 0xff), 8);
+    }
+
+    for (int x = 32 * words; x < width; ++x)
+    {
+        dst[x] = GET_DATA_BIT(src, x) ? 0 : 255;
+    }
+}
+
+
+//! PIX depth which holds image with given count of channels
+static int pixDepthForChannels(int channels)
+{
+    switch (channels)
+    {
+        case 1:
+            return 8;
+        case 3:
+        case 4:
+            return 32;
         default:
             CV_Error(cv::Error::StsError, "Cannot convert RAW image to Pix\n");
     }
-    pixSetYRes(pix, 300);
+
+    return 0;
+}
+
+Pix* prl::opencvToLeptonica(const cv::Mat* inputImage)
+{
+    if (inputImage->depth() != CV_8U)
+    {
+        CV_Error(cv::Error::StsError, "Cannot convert RAW image to Pix\n");
+    }
+
+    Pix* pix = pixCreateNoInit(inputImage->cols, inputImage->rows, pixDepthForChannels(inputImage->channels()));
+    opencvToLeptonica(*inputImage, pix);
     return pix;
 }
 
-cv::Mat prl::leptonicaToOpenCV(Pix* inputImage)
+void prl::opencvToLeptonica(const cv::Mat& inputImage, PIX* outputImage)
 {
-    int width = pixGetWidth(inputImage);
-    int height = pixGetHeight(inputImage);
-    int bytes_per_pixel = pixGetDepth(inputImage);
+    const int width = inputImage.cols;
+    const int height = inputImage.rows;
 
-    int type = 0;
+    if (inputImage.depth() != CV_8U)
+    {
+        CV_Error(cv::Error::StsError, "Cannot convert RAW image to Pix\n");
+    }
+
+    CV_Assert(outputImage && pixGetWidth(outputImage) == width && pixGetHeight(outputImage) == height &&
+              pixGetDepth(outputImage) == pixDepthForChannels(inputImage.channels()));
 
-    switch (bytes_per_pixel)
+    l_uint32* data = pixGetData(outputImage);
+    const int wpl = pixGetWpl(outputImage);
+
+    switch (inputImage.channels())
     {
         case 1:
-        case 8:
-            type = CV_8UC1;
-            break;
-        case 24:
-            type = CV_8UC3;
+            forEachRow(height, width, [&](int y)
+            {
+                grayRowToPix(inputImage.ptr<uchar>(y), data + y * wpl, width);
+            });
+            pixSetSpp(outputImage, 1);
             break;
-        case 32:
-            type = CV_8UC3;
+
+        case 3:
+            forEachRow(height, width, [&](int y)
+            {
+                bgrRowToPix(inputImage.ptr<uchar>(y), data + y * wpl, width);
+            });
+            pixSetSpp(outputImage, 3);
             break;
-        default:
-            CV_Error(cv::Error::StsError, "Cannot convert Pix image to cv::Mat\n");
+
+        case 4:
+            forEachRow(height, width, [&](int y)
+            {
+                bgraRowToPix(inputImage.ptr<uchar>(y), data + y * wpl, width);
+            });
+            pixSetSpp(outputImage, 4);
             break;
     }
 
-    cv::Mat mObj(height, width, type);
-    cv::Mat* m = &mObj;
+    pixSetYRes(outputImage, 300);
+}
 
-    unsigned char* imagedata = m->data;
-    int bytes_per_line = m->step;
+cv::Mat prl::leptonicaToOpenCV(Pix* inputImage)
+{
+    cv::Mat mObj;
+    leptonicaToOpenCV(inputImage, mObj);
+    return mObj;
+}
 
-    //The following code is based on tesseract's ImageThresholder.SetImage function
-    int bpp = bytes_per_pixel;
+void prl::leptonicaToOpenCV(PIX* inputImage, cv::Mat& outputImage)
+{
+    CV_Assert(inputImage);
 
-    l_uint32* data = pixGetData(inputImage);
-    int wpl = pixGetWpl(inputImage);
+    const int width = pixGetWidth(inputImage);
+    const int height = pixGetHeight(inputImage);
+    const int depth = pixGetDepth(inputImage);
 
-    const char values[] = {char(255), 0};
+    const l_uint32* data = pixGetData(inputImage);
+    const int wpl = pixGetWpl(inputImage);
 
-    switch (bpp)
+    switch (depth)
     {
         case 1:
-
-            for (int y = 0; y < height; ++y, data += wpl, imagedata += bytes_per_line)
+            outputImage.create(height, width, CV_8UC1);
+            forEachRow(height, width, [&](int y)
             {
-                for (int x = 0; x < width; ++x)
-                {
-                    imagedata[x] = values[GET_DATA_BIT(data, x)];
-                    /*if (imagedata[x / 8] & (0x80 >> (x % 8))) {
-                        CLEAR_DATA_BIT(data, x);
-                    } else {
-                        SET_DATA_BIT(data, x);
-                    }*/
-                }
-            }
+                bitsRowToGray(data + y * wpl, outputImage.ptr<uchar>(y), width);
+            });
             break;
 
         case 8:
-            // Greyscale just copies the bytes in the right order.
-            for (int y = 0; y < height; ++y, data += wpl, imagedata += bytes_per_line)
+            outputImage.create(height, width, CV_8UC1);
+            forEachRow(height, width, [&](int y)
             {
-                for (int x = 0; x < width; ++x)
-                {
-                    //SET_DATA_BYTE(data, x, imagedata[x]);
-                    imagedata[x] = GET_DATA_BYTE(data, x);
-                }
-            }
+                pixRowToGray(data + y * wpl, outputImage.ptr<uchar>(y), width);
+            });
             break;
 
         case 24:
-            // Put the colors in the correct places in the line buffer.
-            for (int y = 0; y < height; ++y, imagedata += bytes_per_line)
+            // Packed RGB bytes
+            outputImage.create(height, width, CV_8UC3);
+            forEachRow(height, width, [&](int y)
             {
-                for (int x = 0; x < width; ++x, ++data)
+                const l_uint32* line = data + y * wpl;
+                uchar* imagedata = outputImage.ptr<uchar>(y);
+                for (int x = 0; x < width; ++x)
                 {
-                    imagedata[3 * x + 0] = GET_DATA_BYTE(data, COLOR_RED);
-                    imagedata[3 * x + 1] = GET_DATA_BYTE(data, COLOR_GREEN);
-                    imagedata[3 * x + 2] = GET_DATA_BYTE(data, COLOR_BLUE);
-
-                    /*SET_DATA_BYTE(data, COLOR_RED, imagedata[3 * x]);
-                    SET_DATA_BYTE(data, COLOR_GREEN, imagedata[3 * x + 1]);
-                    SET_DATA_BYTE(data, COLOR_BLUE, imagedata[3 * x + 2]);*/
+                    imagedata[3 * x + 0] = GET_DATA_BYTE(line, 3 * x + 2);
+                    imagedata[3 * x + 1] = GET_DATA_BYTE(line, 3 * x + 1);
+                    imagedata[3 * x + 2] = GET_DATA_BYTE(line, 3 * x);
                 }
-            }
+            });
             break;
 
         case 32:
-            // Maintain byte order consistency across different endianness.
-            for (int y = 0; y < height; ++y, imagedata += bytes_per_line, data += wpl)
+            outputImage.create(height, width, CV_8UC3);
+            forEachRow(height, width, [&](int y)
             {
-                for (int x = 0; x < width; ++x)
-                {
-                    imagedata[x * 3 + 0] = (data[x] >> 24) & 0xff;
-                    imagedata[x * 3 + 1] = (data[x] >> 16) & 0xff;
-                    imagedata[x * 3 + 2] = (data[x] >> 8) & 0xff;
-                    //imagedata[x * 4 + 3] = (data[x]) & 0xff;
-
-                    //data[x] = (imagedata[x * 4] << 24) | (imagedata[x * 4 + 1] << 16) |
-                    //	(imagedata[x * 4 + 2] << 8) | imagedata[x * 4 + 3];
-                }
-            }
+                pixRowToBgr(data + y * wpl, outputImage.ptr<uchar>(y), width);
+            });
             break;
 
         default:
             CV_Error(cv::Error::StsError, "Cannot convert Pix image to cv::Mat\n");
     }
+}
 
-    return mObj;
-}
\ No newline at end of file
+PIX* prl::opencvToLeptonicaBinary(const cv::Mat& inputImage, int threshold)
+{
+    PIX* pix = pixCreateNoInit(inputImage.cols, inputImage.rows, 1);
+    opencvToLeptonicaBinary(inputImage, pix, threshold);
+    return pix;
+}
+
+void prl::opencvToLeptonicaBinary(const cv::Mat& inputImage, PIX* outputImage, int threshold)
+{
+    CV_Assert(inputImage.type() == CV_8UC1);
+
+    const int width = inputImage.cols;
+    const int height = inputImage.rows;
+
+    CV_Assert(outputImage && pixGetWidth(outputImage) == width && pixGetHeight(outputImage) == height &&
+              pixGetDepth(outputImage) == 1);
+
+    l_uint32* data = pixGetData(outputImage);
+    const int wpl = pixGetWpl(outputImage);
+
+    forEachRow(height, width, [&](int y)
+    {
+        grayRowToBits(inputImage.ptr<uchar>(y), data + y * wpl, width, threshold);
+    });
+
+    pixSetYRes(outputImage, 300);
+}
@@ -35,6 +35,33 @@ namespace prl
 {
 PIX* opencvToLeptonica(const cv::Mat* inputImage);
 cv::Mat leptonicaToOpenCV(PIX* inputImage);
+
+/*!
+ * \brief Convert 8-bit image into existing Leptonica image.
+ * \param[in] inputImage CV_8UC1, CV_8UC3 or CV_8UC4 image.
+ * \param[out] outputImage Image of the same size, 8 bpp for gray input and 32 bpp for color input.
+ */
+void opencvToLeptonica(const cv::Mat& inputImage, PIX* outputImage);
+
+/*!
+ * \brief Convert Leptonica image to 8-bit image.
+ * \param[in] inputImage 1, 8, 24 or 32 bpp image.
+ * \param[out] outputImage Output image, its buffer is reused when size and type already match.
+ */
+void leptonicaToOpenCV(PIX* inputImage, cv::Mat& outputImage);
+
+/*!
+ * \brief Convert 8-bit gray image to 1 bpp Leptonica image.
+ * \param[in] inputImage CV_8UC1 image.
+ * \param[in] threshold Pixels darker than threshold become foreground (black) pixels.
+ * \return 1 bpp image, caller owns it.
+ */
+PIX* opencvToLeptonicaBinary(const cv::Mat& inputImage, int threshold = 128);
+
+/*!
+ * \brief Convert 8-bit gray image into existing 1 bpp Leptonica image of the same size.
+ */
+void opencvToLeptonicaBinary(const cv::Mat& inputImage, PIX* outputImage, int threshold = 128);
 }
 
 #endif //PRLIB_FORMATCONVERT_HPP
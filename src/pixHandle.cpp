@@ -0,0 +1,279 @@
+/*
+    MIT License
+
+    Copyright (c) 2017 Alexander Zaitsev
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "pixHandle.h"
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "formatConvert.h"
+
+//! Maximal count of images kept by the pool
+static const size_t PIX_POOL_CAPACITY = 8;
+//! Maximal total size of pixel data kept by the pool, one 12 MP RGB page fits
+static const size_t PIX_POOL_MAX_BYTES = 64 * 1024 * 1024;
+
+static size_t pixDataBytes(PIX* pix)
+{
+    return static_cast<size_t>(pixGetWpl(pix)) * sizeof(l_uint32) * pixGetHeight(pix);
+}
+
+//! Images released by handles, newest at the back
+class PixPool
+{
+public:
+    ~PixPool()
+    {
+        clear();
+    }
+
+    PIX* take(int width, int height, int depth)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (auto it = m_images.rbegin(); it != m_images.rend(); ++it)
+        {
+            PIX* pix = *it;
+            if (pixGetWidth(pix) == width && pixGetHeight(pix) == height && pixGetDepth(pix) == depth)
+            {
+                m_bytes -= pixDataBytes(pix);
+                m_images.erase(std::next(it).base());
+                return pix;
+            }
+        }
+
+        return nullptr;
+    }
+
+    void put(PIX* pix)
+    {
+        const size_t bytes = pixDataBytes(pix);
+        if (bytes > PIX_POOL_MAX_BYTES)
+        {
+            pixDestroy(&pix);
+            return;
+        }
+
+        std::vector<PIX*> evicted;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            m_images.push_back(pix);
+            m_bytes += bytes;
+            while (m_images.size() > PIX_POOL_CAPACITY || m_bytes > PIX_POOL_MAX_BYTES)
+            {
+                evicted.push_back(m_images.front());
+                m_bytes -= pixDataBytes(m_images.front());
+                m_images.pop_front();
+            }
+        }
+
+        for (PIX* image : evicted)
+        {
+            pixDestroy(&image);
+        }
+    }
+
+    void clear()
+    {
+        std::deque<PIX*> images;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            images.swap(m_images);
+            m_bytes = 0;
+        }
+
+        for (PIX* pix : images)
+        {
+            pixDestroy(&pix);
+        }
+    }
+
+private:
+    std::mutex m_mutex;
+    std::deque<PIX*> m_images;
+    //! Size of pixel data of pooled images
+    size_t m_bytes = 0;
+};
+
+static PixPool& pixPool()
+{
+    static PixPool pool;
+    return pool;
+}
+
+//! Return image to the pool if nobody else references it
+static void recyclePix(PIX* pix)
+{
+    if (pixGetRefcount(pix) == 1 && pixGetData(pix) != nullptr)
+    {
+        pixPool().put(pix);
+    }
+    else
+    {
+        pixDestroy(&pix);
+    }
+}
+
+static bool isLayoutCompatible(int width, int channels, int depth, size_t step, const void* data)
+{
+#ifdef L_BIG_ENDIAN
+    return channels == 1 && depth == CV_8U && step % 4 == 0 && step / 4 == static_cast<size_t>((width + 3) / 4) &&
+           reinterpret_cast<std::uintptr_t>(data) % 4 == 0;
+#else
+    (void) width;
+    (void) channels;
+    (void) depth;
+    (void) step;
+    (void) data;
+    return false;
+#endif
+}
+
+
+prl::PixHandle::PixHandle(PIX* pix) : m_pix(pix)
+{
+}
+
+prl::PixHandle::~PixHandle()
+{
+    reset();
+}
+
+prl::PixHandle::PixHandle(PixHandle&& other) noexcept
+    : m_pix(other.m_pix), m_isDataBorrowed(other.m_isDataBorrowed)
+{
+    other.m_pix = nullptr;
+    other.m_isDataBorrowed = false;
+}
+
+prl::PixHandle& prl::PixHandle::operator=(PixHandle&& other) noexcept
+{
+    if (this != &other)
+    {
+        reset();
+        std::swap(m_pix, other.m_pix);
+        std::swap(m_isDataBorrowed, other.m_isDataBorrowed);
+    }
+
+    return *this;
+}
+
+PIX* prl::PixHandle::release()
+{
+    CV_Assert(!m_isDataBorrowed);
+
+    PIX* pix = m_pix;
+    m_pix = nullptr;
+    return pix;
+}
+
+void prl::PixHandle::reset(PIX* pix)
+{
+    if (m_pix)
+    {
+        if (m_isDataBorrowed)
+        {
+            // Data belongs to cv::Mat
+            pixSetData(m_pix, nullptr);
+            pixDestroy(&m_pix);
+        }
+        else
+        {
+            recyclePix(m_pix);
+        }
+    }
+
+    m_pix = pix;
+    m_isDataBorrowed = false;
+}
+
+prl::PixHandle prl::acquirePix(int width, int height, int depth)
+{
+    PIX* pix = pixPool().take(width, height, depth);
+    if (pix)
+    {
+        // Drop what previous user has attached
+        pixDestroyColormap(pix);
+        pixSetText(pix, nullptr);
+        pixSetSpp(pix, depth == 32 ? 3 : 1);
+        pixSetResolution(pix, 0, 0);
+    }
+    else
+    {
+        pix = pixCreateNoInit(width, height, depth);
+    }
+
+    return PixHandle(pix);
+}
+
+void prl::clearPixPool()
+{
+    pixPool().clear();
+}
+
+prl::PixHandle prl::pixView(const cv::Mat& image)
+{
+    PixHandle handle;
+
+    if (isLayoutCompatible(image.cols, image.channels(), image.depth(), image.step[0], image.data))
+    {
+        PIX* pix = pixCreateHeader(image.cols, image.rows, 8);
+        pixSetData(pix, reinterpret_cast<l_uint32*>(image.data));
+        pixSetYRes(pix, 300);
+
+        handle.m_pix = pix;
+        handle.m_isDataBorrowed = true;
+    }
+
+    return handle;
+}
+
+cv::Mat prl::matView(PIX* pix)
+{
+    const size_t step = static_cast<size_t>(pixGetWpl(pix)) * sizeof(l_uint32);
+    if (pixGetDepth(pix) != 8 || pixGetColormap(pix) != nullptr ||
+        !isLayoutCompatible(pixGetWidth(pix), 1, CV_8U, step, pixGetData(pix)))
+    {
+        return cv::Mat();
+    }
+
+    return cv::Mat(pixGetHeight(pix), pixGetWidth(pix), CV_8UC1, pixGetData(pix), step);
+}
+
+prl::PixHandle prl::matToPix(const cv::Mat& image)
+{
+    PixHandle view = pixView(image);
+    if (view)
+    {
+        return view;
+    }
+
+    PixHandle pix = acquirePix(image.cols, image.rows, image.channels() == 1 ? 8 : 32);
+    opencvToLeptonica(image, pix.get());
+    return pix;
+}
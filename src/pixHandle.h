@@ -0,0 +1,120 @@
+/*
+    MIT License
+
+    Copyright (c) 2017 Alexander Zaitsev
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef PRLIB_PIXHANDLE_HPP
+#define PRLIB_PIXHANDLE_HPP
+
+#include <opencv2/core/core.hpp>
+
+#include <leptonica/allheaders.h>
+
+
+namespace prl
+{
+/*!
+ * \brief Owning handle of Leptonica image.
+ * \details On destruction image is returned to the PIX pool (see acquirePix()) or destroyed.
+ * Handle made by pixView() does not own pixel data, it only aliases cv::Mat buffer.
+ */
+class CV_EXPORTS PixHandle
+{
+public:
+    PixHandle() = default;
+
+    //! Take ownership of pix
+    explicit PixHandle(PIX* pix);
+
+    ~PixHandle();
+
+    PixHandle(PixHandle&& other) noexcept;
+
+    PixHandle& operator=(PixHandle&& other) noexcept;
+
+    PixHandle(const PixHandle&) = delete;
+
+    PixHandle& operator=(const PixHandle&) = delete;
+
+    PIX* get() const
+    {
+        return m_pix;
+    }
+
+    //! Give up ownership, caller is responsible for pixDestroy()
+    PIX* release();
+
+    //! Replace owned image, previous one is returned to the pool
+    void reset(PIX* pix = nullptr);
+
+    explicit operator bool() const
+    {
+        return m_pix != nullptr;
+    }
+
+private:
+    friend PixHandle pixView(const cv::Mat& image);
+
+    PIX* m_pix = nullptr;
+    bool m_isDataBorrowed = false;
+};
+
+/*!
+ * \brief Get image from the pool of released images or allocate new one.
+ * \param[in] width Image width.
+ * \param[in] height Image height.
+ * \param[in] depth Bits per pixel.
+ * \return Image with undefined content. The pool is thread-safe and keeps at most 8 images
+ * and 64 MB of pixel data, older images are destroyed first.
+ */
+CV_EXPORTS PixHandle acquirePix(int width, int height, int depth);
+
+/*!
+ * \brief Destroy all pooled images.
+ */
+CV_EXPORTS void clearPixPool();
+
+/*!
+ * \brief Make Leptonica image which shares pixel data with cv::Mat.
+ * \param[in] image Input image, it must outlive returned handle.
+ * \return Empty handle if memory layouts are not compatible.
+ * \note Leptonica stores leftmost pixel in the most significant byte of a 32-bit word,
+ * so 8-bit buffers are compatible only on big-endian machines with 4-byte aligned rows.
+ */
+CV_EXPORTS PixHandle pixView(const cv::Mat& image);
+
+/*!
+ * \brief Make cv::Mat header which shares pixel data with Leptonica image.
+ * \param[in] pix Input image, it must outlive returned matrix.
+ * \return Empty matrix if memory layouts are not compatible (see pixView()).
+ */
+CV_EXPORTS cv::Mat matView(PIX* pix);
+
+/*!
+ * \brief Convert cv::Mat to Leptonica image without allocations when possible.
+ * \param[in] image CV_8UC1, CV_8UC3 or CV_8UC4 image.
+ * \return View of image data if layouts are compatible, otherwise pooled copy.
+ */
+CV_EXPORTS PixHandle matToPix(const cv::Mat& image);
+}
+
+#endif //PRLIB_PIXHANDLE_HPP
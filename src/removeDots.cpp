@@ -30,6 +30,8 @@
 #include <opencv2/features2d/features2d.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include "debugSink.h"
+
 void prl::removeDots(const cv::Mat& inputImage, cv::Mat& outputImage, const double radius)
 {
     outputImage = inputImage.clone();
@@ -88,9 +90,16 @@ void prl::removeDots(const cv::Mat& inputImage, cv::Mat& outputImage, const doub
 
     // Fill keypoits by white color.
     // TODO: maybe we should find automatically background color and use it for filling instead of white
-    /*for(const auto& keypoint : filteredKeypoints)
+    for(const auto& keypoint : filteredKeypoints)
     {
-        cv::circle(outputImage, keypoint.pt, keypoint.size / 2.0 + 3, cv::Scalar(255,255,255), cv::FILLED);
-    }*/
-    cv::drawKeypoints(outputImage, keypoints, outputImage, cv::Scalar(0,0,255), cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
-}
\ No newline at end of file
+        cv::circle(outputImage, keypoint.pt, cvRound(keypoint.size / 2.0 + 3), cv::Scalar::all(255), cv::FILLED);
+    }
+
+    if (PRL_DEBUG_ENABLED())
+    {
+        cv::Mat keypointsImage;
+        cv::drawKeypoints(inputImage, filteredKeypoints, keypointsImage, cv::Scalar(0,0,255),
+                          cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
+        prl::publishDebugImage("removeDots_keypoints", keypointsImage);
+    }
+}
@@ -24,15 +24,111 @@
 
 #include "rotate.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include "utils.h"
 
+//! Rotation angle (in radians) up to which two shears are accurate enough
+static const double MAX_TWO_SHEAR_ANGLE = 0.06;
+
+//! Rotation angle (in radians) up to which automatic mode uses shear rotation
+static const double MAX_SHEAR_ANGLE = 10.0 * CV_PI / 180.0;
+
+//! Horizontal shear: row y is moved by shear * (y - center) pixels
+static void shearRows(const cv::Mat& src, cv::Mat& dst, double shear)
+{
+    const double center = (src.rows - 1) / 2.0;
+    const int margin = cvCeil(std::abs(shear) * center);
+
+    dst.create(src.rows, src.cols + 2 * margin, src.type());
+    dst.setTo(cv::Scalar::all(255));
+
+    const size_t rowBytes = src.cols * src.elemSize();
+    for (int y = 0; y < src.rows; ++y)
+    {
+        const int shift = cvRound(shear * (y - center));
+        std::memcpy(dst.ptr(y, margin + shift), src.ptr(y), rowBytes);
+    }
+}
+
+//! Vertical shear: column x is moved by shear * (x - center) pixels
+static void shearColumns(const cv::Mat& src, cv::Mat& dst, double shear)
+{
+    const double center = (src.cols - 1) / 2.0;
+    const int margin = cvCeil(std::abs(shear) * center);
+
+    dst.create(src.rows + 2 * margin, src.cols, src.type());
+    dst.setTo(cv::Scalar::all(255));
+
+    const size_t elemSize = src.elemSize();
+
+    //! Neighbour columns with the same shift form a band, which is copied as row spans
+    int bandStart = 0;
+    while (bandStart < src.cols)
+    {
+        const int shift = cvRound(shear * (bandStart - center));
+
+        int bandEnd = bandStart + 1;
+        while (bandEnd < src.cols && cvRound(shear * (bandEnd - center)) == shift)
+        {
+            ++bandEnd;
+        }
+
+        const size_t bandBytes = (bandEnd - bandStart) * elemSize;
+        for (int y = 0; y < src.rows; ++y)
+        {
+            std::memcpy(dst.ptr(y + margin + shift, bandStart), src.ptr(y, bandStart), bandBytes);
+        }
+
+        bandStart = bandEnd;
+    }
+}
+
+static void rotateShear(const cv::Mat& inputImage, cv::Mat& outputImage, double angle)
+{
+    const double theta = angle * CV_PI / 180.0;
+    const double sinTheta = std::sin(theta);
+    const double cosTheta = std::cos(theta);
+
+    //! Rotation [cos sin; -sin cos] (cv::getRotationMatrix2D convention)
+    //! is decomposed as Hx(tan(theta / 2)) * Vy(-sin(theta)) * Hx(tan(theta / 2))
+    cv::Mat first, second, third;
+    if (std::abs(theta) <= MAX_TWO_SHEAR_ANGLE)
+    {
+        const double shear = std::tan(theta);
+        shearColumns(inputImage, second, -shear);
+        shearRows(second, third, shear);
+    }
+    else
+    {
+        const double shear = std::tan(theta / 2.0);
+        shearRows(inputImage, first, shear);
+        shearColumns(first, second, -sinTheta);
+        shearRows(second, third, shear);
+    }
+
+    //! Crop rotated bounding box around the centre
+    const int width = std::min(third.cols, cvRound(inputImage.rows * std::abs(sinTheta) +
+                                                   inputImage.cols * std::abs(cosTheta)));
+    const int height = std::min(third.rows, cvRound(inputImage.rows * std::abs(cosTheta) +
+                                                    inputImage.cols * std::abs(sinTheta)));
+
+    const cv::Rect boundingBox((third.cols - width) / 2, (third.rows - height) / 2, width, height);
+    third(boundingBox).copyTo(outputImage);
+}
+
 namespace prl
 {
 void rotate(const cv::Mat& inputImage, cv::Mat& outputImage, double angle)
+{
+    rotate(inputImage, outputImage, angle, RotationMode::INTERPOLATION);
+}
+
+void rotate(const cv::Mat& inputImage, cv::Mat& outputImage, double angle, RotationMode mode)
 {
     angle = std::fmod(angle, 360.0);
     if (eq_d(angle, 90.0))
@@ -55,19 +151,25 @@ void rotate(const cv::Mat& inputImage, cv::Mat& outputImage, double angle)
         cv::flip(outputImage, outputImage, 0);
         return;
     }
-    else
+
+    if (mode == RotationMode::AUTO)
     {
-        outputImage = inputImage.clone();
-        cv::bitwise_not(inputImage, inputImage);
+        const bool isSmallAngle = std::abs(angle * CV_PI / 180.0) <= MAX_SHEAR_ANGLE;
+        mode = (isSmallAngle && isBinary(inputImage)) ? RotationMode::SHEAR : RotationMode::INTERPOLATION;
+    }
 
-        int len = std::max(outputImage.cols, outputImage.rows);
+    if (mode == RotationMode::SHEAR)
+    {
+        rotateShear(inputImage, outputImage, angle);
+    }
+    else
+    {
+        int len = std::max(inputImage.cols, inputImage.rows);
         cv::Point2f pt(static_cast<float>(len / 2.0), static_cast<float>(len / 2.0));
         cv::Mat r = cv::getRotationMatrix2D(pt, angle, 1.0);
 
-        cv::warpAffine(inputImage, outputImage, r, cv::Size(len, len));
-
-        cv::bitwise_not(inputImage, inputImage);
-        cv::bitwise_not(outputImage, outputImage);
+        cv::warpAffine(inputImage, outputImage, r, cv::Size(len, len),
+                       cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar::all(255));
     }
 }
 }
\ No newline at end of file
@@ -29,6 +29,16 @@
 
 namespace prl
 {
+/*!
+ * \brief Rotation methods for angles which are not multiple of 90 degrees.
+ */
+enum class RotationMode
+{
+    INTERPOLATION,  //!< Bilinear interpolation on len x len canvas (len is the long image side).
+    SHEAR,          //!< Three-shear (two-shear for tiny angles) rotation, pixels are moved without interpolation.
+    AUTO            //!< SHEAR for binary images and small angles, INTERPOLATION otherwise.
+};
+
 /*!
  * \brief Rotate image.
  * \param[in] inputImage Input image.
@@ -37,6 +47,19 @@ namespace prl
  * \details Rotate image by provided angle.
  */
 CV_EXPORTS void rotate(const cv::Mat& inputImage, cv::Mat& outputImage, double angle);
+
+/*!
+ * \brief Rotate image with selected method.
+ * \param[in] inputImage Input image.
+ * \param[out] outputImage Output image.
+ * \param[in] angle Rotation angle in degrees.
+ * \param[in] mode Rotation method.
+ * \details Right angles are always done by transpose/flip.
+ * Shear rotation only moves row and column spans, so it keeps binary images binary
+ * and does not smear edges. Its output has the size of the rotated bounding box.
+ * Uncovered area is filled by white color.
+ */
+CV_EXPORTS void rotate(const cv::Mat& inputImage, cv::Mat& outputImage, double angle, RotationMode mode);
 }
 
 #endif //PRLIB_ROTATE
@@ -83,4 +83,26 @@ double prl::compareImages(const cv::Mat& image1, const cv::Mat& image2)
     }
 
     return percent;
-}
\ No newline at end of file
+}
+
+bool prl::isBinary(const cv::Mat& image)
+{
+    if (image.empty() || image.type() != CV_8UC1)
+    {
+        return false;
+    }
+
+    for (int y = 0; y < image.rows; ++y)
+    {
+        const uchar* row = image.ptr<uchar>(y);
+        for (int x = 0; x < image.cols; ++x)
+        {
+            if (row[x] != 0 && row[x] != 255)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
@@ -34,5 +34,12 @@ bool eq_d(const double v1, const double v2, const double delta = 1e-7);
 
 double compareImages(const cv::Mat& image1, const cv::Mat& image2);
 
+/*!
+ * \brief Check whether image is binary.
+ * \param[in] image Input image.
+ * \return true if image is CV_8UC1 and contains only 0 and 255 values.
+ */
+bool isBinary(const cv::Mat& image);
+
 }
 #endif //PRLIB_UTILS_HPP
@@ -0,0 +1,167 @@
+/*
+    MIT License
+
+    Copyright (c) 2017 Alexander Zaitsev
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "backgroundNormalization.h"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*!
+ * Allowed mean absolute difference between NATIVE and LEPTONICA results, in gray levels.
+ * NATIVE upsamples the inverse map bilinearly while Leptonica applies it per tile, so single
+ * pixels near sharp background edges may differ a lot, but the mean stays small. Measured against
+ * Leptonica 1.87.0 on test_data/binarize, HolePunch and auto_crop (gray and color, 306 runs):
+ * median 1.1, worst 6.34 (binarize/0041.png, 179x69 pixels). Synthetic pages below: 0.6 - 1.5.
+ */
+static const double MAX_MEAN_DIFFERENCE = 8.0;
+
+static int failuresCount = 0;
+
+static void check(bool condition, const std::string& name)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << name << std::endl;
+        ++failuresCount;
+    }
+}
+
+//! Unevenly lit page with a grid of dark "words"
+static cv::Mat syntheticPage(int rows, int cols, bool isColor)
+{
+    cv::Mat page(rows, cols, isColor ? CV_8UC3 : CV_8UC1);
+    for (int y = 0; y < rows; ++y)
+    {
+        uchar* row = page.ptr<uchar>(y);
+        for (int x = 0; x < cols; ++x)
+        {
+            const double level = 110.0 + 72.0 * x / cols + 48.0 * y / rows;
+            if (isColor)
+            {
+                row[3 * x + 0] = cv::saturate_cast<uchar>(level * 0.85);
+                row[3 * x + 1] = cv::saturate_cast<uchar>(level * 0.95);
+                row[3 * x + 2] = cv::saturate_cast<uchar>(level);
+            }
+            else
+            {
+                row[x] = cv::saturate_cast<uchar>(level);
+            }
+        }
+    }
+
+    for (int y = 8; y < rows - 8; y += 24)
+    {
+        for (int x = 6; x < cols - 20; x += 37)
+        {
+            page(cv::Rect(x, y, 17, std::min(9, rows - y))).setTo(cv::Scalar::all(25));
+        }
+    }
+
+    return page;
+}
+
+static double meanDifference(const cv::Mat& first, const cv::Mat& second)
+{
+    cv::Mat difference;
+    cv::absdiff(first, second, difference);
+    return cv::mean(difference.reshape(1))[0];
+}
+
+static void compareMethods(const cv::Mat& image, const std::string& name)
+{
+    cv::Mat native;
+    cv::Mat leptonica;
+    prl::backgroundNormalization(image, native, prl::BackgroundNormalizationMethod::NATIVE);
+    prl::backgroundNormalization(image, leptonica, prl::BackgroundNormalizationMethod::LEPTONICA);
+
+    if (native.size() != leptonica.size() || native.type() != leptonica.type())
+    {
+        check(false, name + ": different output format");
+        return;
+    }
+
+    const double difference = meanDifference(native, leptonica);
+    std::cout << name << ": mean difference " << difference << std::endl;
+    check(difference <= MAX_MEAN_DIFFERENCE, name + ": mean difference " + std::to_string(difference));
+}
+
+//! Leptonica returns a copy of images with less than 5 tiles in any direction, NATIVE must do the same
+static void testTinyImage(bool isColor)
+{
+    const cv::Mat page = syntheticPage(40, 30, isColor);
+    cv::Mat native;
+    prl::backgroundNormalization(page, native, prl::BackgroundNormalizationMethod::NATIVE);
+    check(meanDifference(page, native) == 0.0, std::string("tiny image is copied, color ") + (isColor ? "1" : "0"));
+}
+
+int main(int argc, char** argv)
+{
+    testTinyImage(false);
+    testTinyImage(true);
+
+    const cv::Size sizes[] = {cv::Size(217, 301), cv::Size(803, 600), cv::Size(1203, 1001)};
+    for (const cv::Size& size : sizes)
+    {
+        for (const bool isColor : {false, true})
+        {
+            compareMethods(syntheticPage(size.height, size.width, isColor),
+                           "synthetic " + std::to_string(size.width) + "x" + std::to_string(size.height) +
+                               (isColor ? " color" : " gray"));
+        }
+    }
+
+    //! Optional directory with real scans, e.g. test_data/binarize
+    if (argc > 1)
+    {
+        std::vector<cv::String> paths;
+        cv::glob(std::string(argv[1]) + "/*.png", paths);
+        for (const cv::String& path : paths)
+        {
+            const cv::Mat image = cv::imread(path, cv::IMREAD_COLOR);
+            if (image.empty())
+            {
+                continue;
+            }
+
+            cv::Mat gray;
+            cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+            compareMethods(gray, path + " gray");
+            compareMethods(image, path + " color");
+        }
+    }
+
+    if (failuresCount > 0)
+    {
+        std::cerr << failuresCount << " check(s) failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "All background normalization checks passed" << std::endl;
+    return 0;
+}
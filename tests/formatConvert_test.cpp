@@ -0,0 +1,211 @@
+/*
+    MIT License
+
+    Copyright (c) 2017 Alexander Zaitsev
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "formatConvert.h"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <leptonica/allheaders.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+//! Widths around word and SIMD block boundaries (4 pixels per PIX8 word, 16 bytes per SSE block, 32 pixels per PIX1 word)
+static const int TEST_WIDTHS[] = {1, 2, 3, 4, 5, 6, 7, 15, 16, 17, 31, 32, 33, 47, 63, 64, 65, 100, 1001};
+
+//! Extra bytes of every row of the parent image, so that converted ROI has a padded step
+static const int TEST_ROW_PADDING = 13;
+
+static int failuresCount = 0;
+
+static void check(bool condition, const std::string& name, int width)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << name << ", width " << width << std::endl;
+        ++failuresCount;
+    }
+}
+
+//! Random image which is a view into a larger buffer, its step is not equal to cols * elemSize
+static cv::Mat paddedImage(int rows, int cols, int type, cv::RNG& rng)
+{
+    cv::Mat parent(rows, cols + TEST_ROW_PADDING, type);
+    rng.fill(parent, cv::RNG::UNIFORM, 0, 256);
+    return parent(cv::Rect(TEST_ROW_PADDING / 2, 0, cols, rows));
+}
+
+//! Bits of the last PIX word beyond the image width must be zero
+static bool isLineTailClear(PIX* pix)
+{
+    const int width = pixGetWidth(pix);
+    const int depth = pixGetDepth(pix);
+    const int usedBits = (width * depth) % 32;
+    if (usedBits == 0)
+    {
+        return true;
+    }
+
+    const l_uint32 tailMask = 0xffffffffu >> usedBits;
+    const l_uint32* data = pixGetData(pix);
+    const int wpl = pixGetWpl(pix);
+    for (int y = 0; y < pixGetHeight(pix); ++y)
+    {
+        if ((data[y * wpl + (width * depth) / 32] & tailMask) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void testGray(int rows, int width, cv::RNG& rng)
+{
+    const cv::Mat image = paddedImage(rows, width, CV_8UC1, rng);
+
+    PIX* pix = pixCreate(width, rows, 8);
+    //! Garbage in the padding must be overwritten
+    pixSetAllArbitrary(pix, 0xff);
+    prl::opencvToLeptonica(image, pix);
+
+    bool isEqual = true;
+    for (int y = 0; y < rows && isEqual; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            l_uint32 value = 0;
+            pixGetPixel(pix, x, y, &value);
+            if (value != image.at<uchar>(y, x))
+            {
+                isEqual = false;
+                break;
+            }
+        }
+    }
+    check(isEqual, "8UC1 -> PIX8 pixels", width);
+    check(isLineTailClear(pix), "8UC1 -> PIX8 line padding", width);
+
+    cv::Mat roundTrip;
+    prl::leptonicaToOpenCV(pix, roundTrip);
+    check(roundTrip.type() == CV_8UC1 && cv::norm(image, roundTrip, cv::NORM_INF) == 0, "PIX8 -> 8UC1 round trip",
+          width);
+
+    pixDestroy(&pix);
+}
+
+static void testColor(int rows, int width, cv::RNG& rng)
+{
+    const cv::Mat image = paddedImage(rows, width, CV_8UC3, rng);
+
+    PIX* pix = prl::opencvToLeptonica(&image);
+    check(pixGetDepth(pix) == 32, "BGR -> PIX32 depth", width);
+
+    bool isEqual = true;
+    for (int y = 0; y < rows && isEqual; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            l_int32 red = 0, green = 0, blue = 0;
+            pixGetRGBPixel(pix, x, y, &red, &green, &blue);
+            const cv::Vec3b& pixel = image.at<cv::Vec3b>(y, x);
+            if (blue != pixel[0] || green != pixel[1] || red != pixel[2])
+            {
+                isEqual = false;
+                break;
+            }
+        }
+    }
+    check(isEqual, "BGR -> PIX32 channel order", width);
+
+    cv::Mat roundTrip;
+    prl::leptonicaToOpenCV(pix, roundTrip);
+    check(roundTrip.type() == CV_8UC3 && cv::norm(image, roundTrip, cv::NORM_INF) == 0, "PIX32 -> BGR round trip",
+          width);
+
+    pixDestroy(&pix);
+}
+
+static void testBinary(int rows, int width, cv::RNG& rng)
+{
+    cv::Mat image = paddedImage(rows, width, CV_8UC1, rng);
+    cv::threshold(image, image, 127, 255, cv::THRESH_BINARY);
+
+    PIX* pix = pixCreate(width, rows, 1);
+    pixSetAll(pix);
+    prl::opencvToLeptonicaBinary(image, pix);
+
+    bool isEqual = true;
+    for (int y = 0; y < rows && isEqual; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            l_uint32 value = 0;
+            pixGetPixel(pix, x, y, &value);
+            //! Black (0) pixels are foreground, set bits in PIX1
+            if (value != (image.at<uchar>(y, x) == 0 ? 1u : 0u))
+            {
+                isEqual = false;
+                break;
+            }
+        }
+    }
+    check(isEqual, "0/255 -> PIX1 bits", width);
+    check(isLineTailClear(pix), "0/255 -> PIX1 line padding", width);
+
+    cv::Mat roundTrip;
+    prl::leptonicaToOpenCV(pix, roundTrip);
+    check(roundTrip.type() == CV_8UC1 && cv::norm(image, roundTrip, cv::NORM_INF) == 0, "PIX1 -> 0/255 round trip",
+          width);
+
+    pixDestroy(&pix);
+}
+
+int main()
+{
+    cv::RNG rng(0x5eed);
+
+    for (const int width : TEST_WIDTHS)
+    {
+        testGray(5, width, rng);
+        testColor(5, width, rng);
+        testBinary(5, width, rng);
+    }
+
+    //! Large enough for row-parallel conversion
+    const int largeWidth = 1203;
+    testGray(900, largeWidth, rng);
+    testColor(900, largeWidth, rng);
+    testBinary(900, largeWidth, rng);
+
+    if (failuresCount > 0)
+    {
+        std::cerr << failuresCount << " check(s) failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "All format conversion checks passed" << std::endl;
+    return 0;
+}
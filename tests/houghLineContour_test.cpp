@@ -0,0 +1,139 @@
+/*
+    MIT License
+
+    Copyright (c) 2017 Alexander Zaitsev
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "houghLine.h"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*!
+ * Allowed corner shift against the reference quads, in pixels. The reference search computed
+ * every corner from its own ordered pair of lines, so float rounding moves a corner by 1 pixel
+ * at most (photo_2017-10-03_23-31-12.jpg).
+ */
+static const int MAX_CORNER_SHIFT = 2;
+
+static int failuresCount = 0;
+
+static void check(bool condition, const std::string& name)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << name << std::endl;
+        ++failuresCount;
+    }
+}
+
+struct ReferenceQuad
+{
+    const char* fileName;
+    cv::Point corners[4];
+};
+
+//! Quads of the ordered 4-tuple search over the same 20 lines, on test_data/auto_crop
+static const ReferenceQuad REFERENCE_QUADS[] = {
+        {"6.jpg", {{690, 46}, {488, 45}, {101, 433}, {690, 433}}},
+        {"Blank_book_on_a_table.jpg", {{34, 1180}, {1139, 1141}, {146, 148}, {142, 148}}},
+        {"IMG_8135.JPG", {{124, 1424}, {1170, 1442}, {1170, 290}, {379, 401}}},
+        {"Paper_450x450.jpg", {{344, 60}, {33, 10}, {18, 452}, {424, 438}}},
+        {"Photography 001.JPG", {{1237, 889}, {1209, 357}, {440, 344}, {227, 800}}},
+        {"YTD2K2g.jpg", {{86, 419}, {599, 410}, {543, 17}, {100, 17}}},
+        {"jbareham_161117_1286_0076_02.0.jpeg", {{3, 40}, {16, 797}, {1172, 797}, {1185, 81}}},
+        {"paper-on-table1.jpg", {{36, 104}, {274, 2367}, {3153, 2216}, {3046, 155}}},
+        {"photo_2017-10-03_20-29-18.jpg", {{663, 247}, {57, 268}, {14, 884}, {685, 872}}},
+        {"photo_2017-10-03_23-31-11 (2).jpg", {{318, 40}, {77, 1174}, {752, 1174}, {772, 9}}},
+        {"photo_2017-10-03_23-31-11.jpg", {{903, 254}, {117, 227}, {117, 1229}, {687, 1118}}},
+        {"photo_2017-10-03_23-31-12 (2).jpg", {{1166, 38}, {80, 114}, {49, 710}, {1134, 941}}},
+        {"photo_2017-10-03_23-31-12.jpg", {{778, 20}, {4, 7}, {3, 1263}, {778, 1263}}},
+        {"photo_2017-10-03_23-31-13 (2).jpg", {{812, 1219}, {74, 1258}, {95, 5}, {791, 29}}},
+        {"photo_2017-10-03_23-31-13.jpg", {{72, 290}, {138, 828}, {866, 1036}, {144, 314}}},
+        {"photo_2017-10-03_23-31-14.jpg", {{54, 45}, {149, 1136}, {829, 456}, {927, 137}}},
+};
+
+//! Every reference corner has its own found corner nearby, vertex order and start are ignored
+static bool isSameQuad(const std::vector<cv::Point>& contour, const cv::Point (&corners)[4])
+{
+    if (contour.size() != 4)
+    {
+        return false;
+    }
+
+    bool isUsed[4] = {false, false, false, false};
+    for (const cv::Point& corner : corners)
+    {
+        bool isFound = false;
+        for (size_t i = 0; i < contour.size() && !isFound; ++i)
+        {
+            if (!isUsed[i] && std::abs(contour[i].x - corner.x) <= MAX_CORNER_SHIFT &&
+                std::abs(contour[i].y - corner.y) <= MAX_CORNER_SHIFT)
+            {
+                isUsed[i] = true;
+                isFound = true;
+            }
+        }
+        if (!isFound)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: houghLineContour_test <test_data/auto_crop>" << std::endl;
+        return 1;
+    }
+
+    for (const ReferenceQuad& reference : REFERENCE_QUADS)
+    {
+        const std::string path = std::string(argv[1]) + "/" + reference.fileName;
+        cv::Mat image = cv::imread(path, cv::IMREAD_COLOR);
+        if (image.empty())
+        {
+            check(false, path + ": can't read image");
+            continue;
+        }
+
+        std::vector<cv::Point> contour;
+        const bool isFound = prl::findHoughLineContour(image, contour);
+        check(isFound && isSameQuad(contour, reference.corners), path + ": quad differs from reference");
+    }
+
+    if (failuresCount > 0)
+    {
+        std::cerr << failuresCount << " check(s) failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "All Hough line contour checks passed" << std::endl;
+    return 0;
+}
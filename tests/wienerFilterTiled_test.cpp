@@ -0,0 +1,165 @@
+/*
+    MIT License
+
+    Copyright (c) 2017 Alexander Zaitsev
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "wienerFilter.h"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+static const int KERNEL_SIZE = 11;
+static const double SIGMA_GAUSS = 5.0;
+
+/*!
+ * Allowed differences between wienerFilterTiled() and wienerFilter(), in gray levels.
+ * Global filter pads the image by only half a kernel before the DFT, so its outer rows and columns
+ * carry wrap-around, while tiles are reflected by two kernels. That band is excluded from the maximum.
+ * Measured on the pages below with a port of both filters: interior maximum 1 (coeffWiener 1) and
+ * 3 (coeffWiener 0.1), mean 0.014 and 0.41.
+ */
+struct Tolerance
+{
+    double coeffWiener;
+    double maxInteriorDifference;
+    double maxMeanDifference;
+};
+
+static const Tolerance TOLERANCES[] = {{1.0, 2.0, 0.05}, {0.1, 5.0, 0.6}};
+
+static int failuresCount = 0;
+
+static void check(bool condition, const std::string& name)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << name << std::endl;
+        ++failuresCount;
+    }
+}
+
+//! Unevenly lit page with a grid of dark "words", slightly defocused
+static cv::Mat syntheticPage(int rows, int cols, bool isColor)
+{
+    cv::Mat page(rows, cols, isColor ? CV_8UC3 : CV_8UC1);
+    for (int y = 0; y < rows; ++y)
+    {
+        uchar* row = page.ptr<uchar>(y);
+        for (int x = 0; x < cols; ++x)
+        {
+            const double level = 110.0 + 72.0 * x / cols + 48.0 * y / rows;
+            if (isColor)
+            {
+                row[3 * x + 0] = cv::saturate_cast<uchar>(level * 0.85);
+                row[3 * x + 1] = cv::saturate_cast<uchar>(level * 0.95);
+                row[3 * x + 2] = cv::saturate_cast<uchar>(level);
+            }
+            else
+            {
+                row[x] = cv::saturate_cast<uchar>(level);
+            }
+        }
+    }
+
+    for (int y = 8; y < rows - 8; y += 24)
+    {
+        for (int x = 6; x < cols - 20; x += 37)
+        {
+            page(cv::Rect(x, y, 17, std::min(9, rows - y))).setTo(cv::Scalar::all(25));
+        }
+    }
+
+    cv::GaussianBlur(page, page, cv::Size(0, 0), 1.5);
+    return page;
+}
+
+static void compareWithGlobal(const cv::Mat& image, int tileSize, const Tolerance& tolerance, const std::string& name)
+{
+    cv::Mat global;
+    cv::Mat tiled;
+    prl::wienerFilter(image, global, KERNEL_SIZE, KERNEL_SIZE, tolerance.coeffWiener, SIGMA_GAUSS);
+    prl::wienerFilterTiled(image, tiled, KERNEL_SIZE, KERNEL_SIZE, tolerance.coeffWiener, SIGMA_GAUSS, tileSize);
+
+    if (global.size() != tiled.size() || global.type() != tiled.type())
+    {
+        check(false, name + ": different output format");
+        return;
+    }
+
+    cv::Mat difference;
+    cv::absdiff(global, tiled, difference);
+    difference = difference.reshape(1, difference.rows);
+
+    const cv::Rect interior(KERNEL_SIZE * image.channels(), KERNEL_SIZE,
+                            difference.cols - 2 * KERNEL_SIZE * image.channels(), difference.rows - 2 * KERNEL_SIZE);
+    double maxInteriorDifference = 0.0;
+    cv::minMaxLoc(difference(interior), nullptr, &maxInteriorDifference);
+    const double meanDifference = cv::mean(difference)[0];
+
+    std::cout << name << ": interior max difference " << maxInteriorDifference << ", mean difference "
+              << meanDifference << std::endl;
+    check(maxInteriorDifference <= tolerance.maxInteriorDifference,
+          name + ": interior max difference " + std::to_string(maxInteriorDifference));
+    check(meanDifference <= tolerance.maxMeanDifference, name + ": mean difference " + std::to_string(meanDifference));
+}
+
+int main()
+{
+    struct Layout
+    {
+        cv::Size imageSize;
+        int tileSize;
+    };
+
+    //! Several tiles with partial ones at the right and bottom, and a single tile larger than the image
+    const Layout layouts[] = {{cv::Size(803, 600), 256}, {cv::Size(1203, 1001), 512},
+                              {cv::Size(217, 301), 100}, {cv::Size(217, 301), 512}};
+
+    for (const Tolerance& tolerance : TOLERANCES)
+    {
+        for (const Layout& layout : layouts)
+        {
+            for (const bool isColor : {false, true})
+            {
+                compareWithGlobal(syntheticPage(layout.imageSize.height, layout.imageSize.width, isColor),
+                                  layout.tileSize, tolerance,
+                                  "K " + std::to_string(tolerance.coeffWiener) + ", " +
+                                      std::to_string(layout.imageSize.width) + "x" +
+                                      std::to_string(layout.imageSize.height) + ", tile " +
+                                      std::to_string(layout.tileSize) + (isColor ? ", color" : ", gray"));
+            }
+        }
+    }
+
+    if (failuresCount > 0)
+    {
+        std::cerr << failuresCount << " check(s) failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "All tiled Wiener filter checks passed" << std::endl;
+    return 0;
+}